@@ -47,6 +47,7 @@ static void file_free_rcu(struct rcu_head *head)
 	struct file *f = container_of(head, struct file, f_u.fu_rcuhead);
 
 	put_cred(f->f_cred);
+	kfree(f->f_ra.streams);
 	kmem_cache_free(filp_cachep, f);
 }
 
@@ -36,6 +36,11 @@
  */
 #define MIN_WRITEBACK_PAGES	(4096UL >> (PAGE_SHIFT - 10))
 
+/*
+ * Minimal number of b_io inodes for each parallel writeback worker
+ */
+#define WB_WORKER_MIN_INODES	4
+
 /*
  * Passed into wb_writeback(), essentially a subset of writeback_control
  */
@@ -1626,7 +1631,8 @@ static long writeback_chunk_size(struct bdi_writeback *wb,
 }
 
 /*
- * Write a portion of b_io inodes which belong to @sb.
+ * Write a portion of the inodes on @io which belong to @sb.  @io is either
+ * wb->b_io or a parallel writeback worker's share of it.
  *
  * Return the number of pages and/or inodes written.
  *
@@ -1636,7 +1642,8 @@ static long writeback_chunk_size(struct bdi_writeback *wb,
  */
 static long writeback_sb_inodes(struct super_block *sb,
 				struct bdi_writeback *wb,
-				struct wb_writeback_work *work)
+				struct wb_writeback_work *work,
+				struct list_head *io)
 {
 	struct writeback_control wbc = {
 		.sync_mode		= work->sync_mode,
@@ -1652,8 +1659,8 @@ static long writeback_sb_inodes(struct super_block *sb,
 	long write_chunk;
 	long wrote = 0;  /* count both pages and inodes */
 
-	while (!list_empty(&wb->b_io)) {
-		struct inode *inode = wb_inode(wb->b_io.prev);
+	while (!list_empty(io)) {
+		struct inode *inode = wb_inode(io->prev);
 		struct bdi_writeback *tmp_wb;
 
 		if (inode->i_sb != sb) {
@@ -1777,13 +1784,14 @@ static long writeback_sb_inodes(struct super_block *sb,
 }
 
 static long __writeback_inodes_wb(struct bdi_writeback *wb,
-				  struct wb_writeback_work *work)
+				  struct wb_writeback_work *work,
+				  struct list_head *io)
 {
 	unsigned long start_time = jiffies;
 	long wrote = 0;
 
-	while (!list_empty(&wb->b_io)) {
-		struct inode *inode = wb_inode(wb->b_io.prev);
+	while (!list_empty(io)) {
+		struct inode *inode = wb_inode(io->prev);
 		struct super_block *sb = inode->i_sb;
 
 		if (!trylock_super(sb)) {
@@ -1795,7 +1803,7 @@ static long __writeback_inodes_wb(struct bdi_writeback *wb,
 			redirty_tail(inode, wb);
 			continue;
 		}
-		wrote += writeback_sb_inodes(sb, wb, work);
+		wrote += writeback_sb_inodes(sb, wb, work, io);
 		up_read(&sb->s_umount);
 
 		/* refer to the same tests at the end of writeback_sb_inodes */
@@ -1810,6 +1818,151 @@ static long __writeback_inodes_wb(struct bdi_writeback *wb,
 	return wrote;
 }
 
+static long writeback_io_inodes(struct bdi_writeback *wb,
+				struct wb_writeback_work *work,
+				struct list_head *io)
+{
+	if (work->sb)
+		return writeback_sb_inodes(work->sb, wb, work, io);
+	return __writeback_inodes_wb(wb, work, io);
+}
+
+/*
+ * One of the workers writing back a wb in parallel, see wb_writeback_io().
+ */
+struct wb_writeback_worker {
+	struct work_struct work;
+	struct bdi_writeback *wb;
+	struct wb_writeback_work wbw;	/* private copy of the work */
+	struct list_head b_io;		/* this worker's share of wb->b_io */
+	long progress;
+};
+
+static void wb_worker_writeback(struct wb_writeback_worker *worker)
+{
+	struct bdi_writeback *wb = worker->wb;
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	spin_lock(&wb->list_lock);
+	worker->progress = writeback_io_inodes(wb, &worker->wbw, &worker->b_io);
+	/* Hand back what didn't fit in this round, it goes first next time */
+	if (!list_empty(&worker->b_io)) {
+		list_splice_tail_init(&worker->b_io, &wb->b_io);
+		wb_io_lists_populated(wb);
+	}
+	spin_unlock(&wb->list_lock);
+	blk_finish_plug(&plug);
+}
+
+static void wb_worker_workfn(struct work_struct *work)
+{
+	struct wb_writeback_worker *worker;
+
+	worker = container_of(work, struct wb_writeback_worker, work);
+	set_worker_desc("flush-%s", bdi_dev_name(worker->wb->bdi));
+	/* Like the flusher itself, see wb_workfn() */
+	current->flags |= PF_SWAPWRITE;
+	wb_worker_writeback(worker);
+	current->flags &= ~PF_SWAPWRITE;
+}
+
+/*
+ * How many workers should write back the current b_io of @wb?  Only go
+ * parallel if each of them gets a few inodes.
+ */
+static unsigned int wb_nr_workers(struct bdi_writeback *wb)
+{
+	unsigned int limit = READ_ONCE(wb->bdi->wb_workers);
+	unsigned int nr = 0;
+	struct inode *inode;
+
+	if (limit <= 1)
+		return 1;
+
+	list_for_each_entry(inode, &wb->b_io, i_io_list)
+		if (++nr >= limit * WB_WORKER_MIN_INODES)
+			break;
+
+	return max(nr / WB_WORKER_MIN_INODES, 1U);
+}
+
+/*
+ * Write back a round of wb->b_io, splitting it between up to
+ * bdi->wb_workers workers.
+ *
+ * Inodes are dealt out round-robin, so each worker writes its share in
+ * b_io order and an inode is only ever on one worker's list, which keeps
+ * two workers from writing the same inode.  The pages budget is split
+ * evenly: WB_SYNC_ALL and tagged works have an unlimited budget and each
+ * worker still writes all of its inodes in one go, while background and
+ * kupdate works write no more in a round than a single flusher would and
+ * come back to wb_writeback() to check their termination conditions just
+ * as often.
+ *
+ * The flusher itself is the first worker.  Workers that haven't started
+ * by the time it is done with its own share are run inline rather than
+ * waited for, as bdi_wq may be down to its rescuer under memory pressure.
+ *
+ * Called with wb->list_lock held, which may be dropped and reacquired.
+ */
+static long wb_writeback_io(struct bdi_writeback *wb,
+			    struct wb_writeback_work *work)
+{
+	struct wb_writeback_worker *workers;
+	struct inode *inode, *next;
+	unsigned int nr, i;
+	long nr_pages, progress = 0;
+
+	nr = wb_nr_workers(wb);
+	if (nr <= 1)
+		return writeback_io_inodes(wb, work, &wb->b_io);
+
+	workers = kcalloc(nr, sizeof(*workers), GFP_NOWAIT | __GFP_NOWARN);
+	if (!workers)
+		return writeback_io_inodes(wb, work, &wb->b_io);
+
+	if (work->nr_pages == LONG_MAX || work->sync_mode == WB_SYNC_ALL ||
+	    work->tagged_writepages)
+		nr_pages = LONG_MAX;
+	else
+		nr_pages = DIV_ROUND_UP(work->nr_pages, nr);
+	for (i = 0; i < nr; i++) {
+		INIT_WORK(&workers[i].work, wb_worker_workfn);
+		workers[i].wb = wb;
+		workers[i].wbw = *work;
+		workers[i].wbw.nr_pages = nr_pages;
+		INIT_LIST_HEAD(&workers[i].b_io);
+	}
+
+	i = 0;
+	list_for_each_entry_safe(inode, next, &wb->b_io, i_io_list) {
+		list_move_tail(&inode->i_io_list, &workers[i].b_io);
+		if (++i == nr)
+			i = 0;
+	}
+	spin_unlock(&wb->list_lock);
+
+	for (i = 1; i < nr; i++)
+		queue_work(bdi_wq, &workers[i].work);
+
+	wb_worker_writeback(&workers[0]);
+
+	for (i = 1; i < nr; i++) {
+		if (cancel_work_sync(&workers[i].work))
+			wb_worker_writeback(&workers[i]);
+	}
+
+	for (i = 0; i < nr; i++) {
+		work->nr_pages -= nr_pages - workers[i].wbw.nr_pages;
+		progress += workers[i].progress;
+	}
+	kfree(workers);
+
+	spin_lock(&wb->list_lock);
+	return progress;
+}
+
 static long writeback_inodes_wb(struct bdi_writeback *wb, long nr_pages,
 				enum wb_reason reason)
 {
@@ -1825,7 +1978,7 @@ static long writeback_inodes_wb(struct bdi_writeback *wb, long nr_pages,
 	spin_lock(&wb->list_lock);
 	if (list_empty(&wb->b_io))
 		queue_io(wb, &work, jiffies);
-	__writeback_inodes_wb(wb, &work);
+	__writeback_inodes_wb(wb, &work, &wb->b_io);
 	spin_unlock(&wb->list_lock);
 	blk_finish_plug(&plug);
 
@@ -1898,10 +2051,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		trace_writeback_start(wb, work);
 		if (list_empty(&wb->b_io))
 			queue_io(wb, work, dirtied_before);
-		if (work->sb)
-			progress = writeback_sb_inodes(work->sb, wb, work);
-		else
-			progress = __writeback_inodes_wb(wb, work);
+		progress = wb_writeback_io(wb, work);
 		trace_writeback_written(wb, work);
 
 		wb_update_bandwidth(wb, wb_start);
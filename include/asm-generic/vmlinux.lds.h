@@ -196,6 +196,15 @@
 #define BRANCH_PROFILE()
 #endif
 
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+#define ALLOC_TAGS()		. = ALIGN(8);				\
+				__start_alloc_tags = .;			\
+				KEEP(*(alloc_tags))			\
+				__stop_alloc_tags = .;
+#else
+#define ALLOC_TAGS()
+#endif
+
 #ifdef CONFIG_KPROBES
 #define KPROBE_BLACKLIST()	. = ALIGN(8);				      \
 				__start_kprobe_blacklist = .;		      \
@@ -345,6 +354,7 @@
 	__stop___dyndbg = .;						\
 	LIKELY_PROFILE()		       				\
 	BRANCH_PROFILE()						\
+	ALLOC_TAGS()							\
 	TRACE_PRINTKS()							\
 	BPF_RAW_TP()							\
 	TRACEPOINT_STR()
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Allocation profiling: each call site of the page and slab allocators
+ * owns a static alloc_tag, which counts the bytes and the number of
+ * allocations it currently has live.  See Documentation/vm/allocation-profiling.rst
+ */
+#ifndef _LINUX_ALLOC_TAG_H
+#define _LINUX_ALLOC_TAG_H
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+#include <linux/jump_label.h>
+#include <asm/percpu.h>
+
+struct alloc_tag_counters {
+	u64 bytes;
+	u64 calls;
+};
+
+/*
+ * An instance of this structure is created in the "alloc_tags" section
+ * for every allocation call site.  The counters are per-cpu so that
+ * allocating and freeing only cost a couple of per-cpu updates.
+ */
+struct alloc_tag {
+	const char *function;
+	const char *filename;
+	unsigned int lineno;
+	struct alloc_tag_counters __percpu *counters;
+} __aligned(8);
+
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+struct ctl_table;
+
+int mem_profiling_sysctl_handler(struct ctl_table *table, int write,
+				 void *buffer, size_t *lenp, loff_t *ppos);
+#endif
+
+#if defined(CONFIG_MEM_ALLOC_PROFILING) && !defined(MODULE)
+
+/* For alloc_tag_save() and alloc_tag_restore() */
+#include <linux/sched.h>
+
+#ifdef CONFIG_MEM_ALLOC_PROFILING_ENABLED_BY_DEFAULT
+DECLARE_STATIC_KEY_TRUE(mem_alloc_profiling_key);
+#else
+DECLARE_STATIC_KEY_FALSE(mem_alloc_profiling_key);
+#endif
+
+static inline bool mem_alloc_profiling_enabled(void)
+{
+#ifdef CONFIG_MEM_ALLOC_PROFILING_ENABLED_BY_DEFAULT
+	return static_branch_likely(&mem_alloc_profiling_key);
+#else
+	return static_branch_unlikely(&mem_alloc_profiling_key);
+#endif
+}
+
+#define DEFINE_ALLOC_TAG(_alloc_tag)					\
+	static DEFINE_PER_CPU(struct alloc_tag_counters, _alloc_tag##_cntr); \
+	static struct alloc_tag _alloc_tag __used			\
+	__section("alloc_tags") = {					\
+		.function = __func__,					\
+		.filename = __FILE__,					\
+		.lineno = __LINE__,					\
+		.counters = &_alloc_tag##_cntr,				\
+	}
+
+/*
+ * Run the allocation @_do_alloc with the tag of this call site as the
+ * current task's alloc_tag, for the allocator to charge it.  The *_noprof
+ * variants of the allocation functions leave the tag alone, so that an
+ * allocation helper can charge its caller.
+ */
+#define alloc_hooks(_do_alloc)						\
+({									\
+	typeof(_do_alloc) _res;						\
+	if (mem_alloc_profiling_enabled()) {				\
+		DEFINE_ALLOC_TAG(_alloc_tag);				\
+		struct alloc_tag *_old = alloc_tag_save(&_alloc_tag);	\
+		_res = _do_alloc;					\
+		alloc_tag_restore(_old);				\
+	} else								\
+		_res = _do_alloc;					\
+	_res;								\
+})
+
+#elif defined(CONFIG_MEM_ALLOC_PROFILING) /* MODULE */
+
+#include <linux/sched.h>
+
+static inline bool mem_alloc_profiling_enabled(void)
+{
+	return false;
+}
+
+/*
+ * Module call sites have no tags: /proc/allocinfo only walks the
+ * "alloc_tags" section of vmlinux.  Clear the current task's alloc_tag
+ * for the allocation, so that it is not charged to whatever core kernel
+ * call site the module code happens to run under.
+ */
+#define alloc_hooks(_do_alloc)						\
+({									\
+	struct alloc_tag *_old = alloc_tag_save(NULL);			\
+	typeof(_do_alloc) _res = _do_alloc;				\
+	alloc_tag_restore(_old);					\
+	_res;								\
+})
+
+#else /* CONFIG_MEM_ALLOC_PROFILING */
+
+static inline bool mem_alloc_profiling_enabled(void)
+{
+	return false;
+}
+
+#define alloc_hooks(_do_alloc)	(_do_alloc)
+
+#endif /* CONFIG_MEM_ALLOC_PROFILING */
+
+#endif /* _LINUX_ALLOC_TAG_H */
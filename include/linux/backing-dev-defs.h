@@ -162,6 +162,9 @@ struct bdi_writeback {
 #endif
 };
 
+/* upper limit for backing_dev_info->wb_workers */
+#define WB_MAX_WORKERS		16
+
 struct backing_dev_info {
 	u64 id;
 	struct rb_node rb_node; /* keyed by ->id */
@@ -173,6 +176,7 @@ struct backing_dev_info {
 	unsigned int capabilities; /* Device capabilities */
 	unsigned int min_ratio;
 	unsigned int max_ratio, max_prop_frac;
+	unsigned int wb_workers;   /* max parallel writeback workers per wb */
 
 	/*
 	 * Sum of avg_write_bw of wbs with dirty inodes.  > 0 if there are
@@ -308,6 +308,7 @@ enum rw_hint {
 #define IOCB_SYNC		(__force int) RWF_SYNC
 #define IOCB_NOWAIT		(__force int) RWF_NOWAIT
 #define IOCB_APPEND		(__force int) RWF_APPEND
+#define IOCB_UNCACHED		(__force int) RWF_UNCACHED
 
 /* non-RWF related bits - start at 16 */
 #define IOCB_EVENTFD		(1 << 16)
@@ -917,6 +918,32 @@ struct fown_struct {
 	int signum;		/* posix.1b rt signal to be delivered on IO */
 };
 
+/*
+ * A sequential stream parked while another stream of the same file is read
+ */
+struct file_ra_stream {
+	pgoff_t start;
+	unsigned int size;		/* 0 if the slot is unused */
+	unsigned int async_size;
+};
+
+#define RA_NR_STREAMS	3
+
+/*
+ * Readahead state for interleaved and strided readers.  Only allocated
+ * for the struct file of a reader that needs it, see ra_get_streams().
+ */
+struct file_ra_streams {
+	/* Interleaved sequential streams, most recently used first */
+	struct file_ra_stream streams[RA_NR_STREAMS];
+
+	pgoff_t stride_last;		/* last strided chunk read (ahead) */
+	pgoff_t stride_marker;		/* strided chunk carrying the marker */
+	unsigned int stride;		/* # of pages between strided chunks */
+	unsigned int stride_size;	/* # of pages in each strided chunk */
+	unsigned int stride_count;	/* strided chunks seen in a row */
+};
+
 /*
  * Track a single file's readahead state
  */
@@ -929,6 +956,10 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	bool boost;			/* reader caught up with readahead, see
+					   page_cache_async_ra() */
+	struct file_ra_streams *streams;	/* NULL until needed */
 };
 
 /*
@@ -2693,6 +2724,8 @@ extern bool filemap_range_has_page(struct address_space *, loff_t lstart,
 				  loff_t lend);
 extern int filemap_write_and_wait_range(struct address_space *mapping,
 				        loff_t lstart, loff_t lend);
+extern int filemap_drop_uncached_range(struct address_space *mapping,
+				       loff_t start, loff_t end);
 extern int __filemap_fdatawrite_range(struct address_space *mapping,
 				loff_t start, loff_t end, int sync_mode);
 extern int filemap_fdatawrite_range(struct address_space *mapping,
@@ -2799,6 +2832,15 @@ static inline ssize_t generic_write_sync(struct kiocb *iocb, ssize_t count)
 			return ret;
 	}
 
+	/* Waiting for the writeback could block, leave the pages be */
+	if ((iocb->ki_flags & (IOCB_UNCACHED | IOCB_DIRECT | IOCB_NOWAIT)) ==
+	    IOCB_UNCACHED) {
+		int ret = filemap_drop_uncached_range(iocb->ki_filp->f_mapping,
+				iocb->ki_pos - count, iocb->ki_pos - 1);
+		if (ret)
+			return ret;
+	}
+
 	return count;
 }
 
@@ -350,6 +350,13 @@ extern unsigned int kobjsize(const void *objp);
 # define VM_MTE_ALLOWED	VM_NONE
 #endif
 
+#ifdef CONFIG_HAVE_ARCH_USERFAULTFD_MINOR
+# define VM_UFFD_MINOR_BIT	37
+# define VM_UFFD_MINOR		BIT(VM_UFFD_MINOR_BIT)	/* UFFD minor faults */
+#else /* !CONFIG_HAVE_ARCH_USERFAULTFD_MINOR */
+# define VM_UFFD_MINOR		VM_NONE
+#endif /* CONFIG_HAVE_ARCH_USERFAULTFD_MINOR */
+
 #ifndef VM_GROWSUP
 # define VM_GROWSUP	VM_NONE
 #endif
@@ -760,34 +767,43 @@ static inline int is_vmalloc_or_module_addr(const void *x)
 }
 #endif
 
-extern void *kvmalloc_node(size_t size, gfp_t flags, int node);
-static inline void *kvmalloc(size_t size, gfp_t flags)
+extern void *kvmalloc_node_noprof(size_t size, gfp_t flags, int node);
+#define kvmalloc_node(...)	alloc_hooks(kvmalloc_node_noprof(__VA_ARGS__))
+
+static inline void *kvmalloc_noprof(size_t size, gfp_t flags)
 {
-	return kvmalloc_node(size, flags, NUMA_NO_NODE);
+	return kvmalloc_node_noprof(size, flags, NUMA_NO_NODE);
 }
-static inline void *kvzalloc_node(size_t size, gfp_t flags, int node)
+#define kvmalloc(...)		alloc_hooks(kvmalloc_noprof(__VA_ARGS__))
+
+static inline void *kvzalloc_node_noprof(size_t size, gfp_t flags, int node)
 {
-	return kvmalloc_node(size, flags | __GFP_ZERO, node);
+	return kvmalloc_node_noprof(size, flags | __GFP_ZERO, node);
 }
-static inline void *kvzalloc(size_t size, gfp_t flags)
+#define kvzalloc_node(...)	alloc_hooks(kvzalloc_node_noprof(__VA_ARGS__))
+
+static inline void *kvzalloc_noprof(size_t size, gfp_t flags)
 {
-	return kvmalloc(size, flags | __GFP_ZERO);
+	return kvmalloc_noprof(size, flags | __GFP_ZERO);
 }
+#define kvzalloc(...)		alloc_hooks(kvzalloc_noprof(__VA_ARGS__))
 
-static inline void *kvmalloc_array(size_t n, size_t size, gfp_t flags)
+static inline void *kvmalloc_array_noprof(size_t n, size_t size, gfp_t flags)
 {
 	size_t bytes;
 
 	if (unlikely(check_mul_overflow(n, size, &bytes)))
 		return NULL;
 
-	return kvmalloc(bytes, flags);
+	return kvmalloc_noprof(bytes, flags);
 }
+#define kvmalloc_array(...)	alloc_hooks(kvmalloc_array_noprof(__VA_ARGS__))
 
-static inline void *kvcalloc(size_t n, size_t size, gfp_t flags)
+static inline void *kvcalloc_noprof(size_t n, size_t size, gfp_t flags)
 {
-	return kvmalloc_array(n, size, flags | __GFP_ZERO);
+	return kvmalloc_array_noprof(n, size, flags | __GFP_ZERO);
 }
+#define kvcalloc(...)		alloc_hooks(kvcalloc_noprof(__VA_ARGS__))
 
 extern void kvfree(const void *addr);
 extern void kvfree_sensitive(const void *addr, size_t len);
@@ -3038,6 +3054,12 @@ int vmemmap_populate_basepages(unsigned long start, unsigned long end,
 int vmemmap_populate(unsigned long start, unsigned long end, int node,
 		struct vmem_altmap *altmap);
 void vmemmap_populate_print_last(void);
+#ifdef CONFIG_HUGETLB_PAGE_FREE_VMEMMAP
+int vmemmap_remap_free(unsigned long start, unsigned long end,
+		       unsigned long reuse);
+int vmemmap_remap_alloc(unsigned long start, unsigned long end,
+			unsigned long reuse, gfp_t gfp_mask);
+#endif
 #ifdef CONFIG_MEMORY_HOTPLUG
 void vmemmap_free(unsigned long start, unsigned long end,
 		struct vmem_altmap *altmap);
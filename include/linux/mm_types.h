@@ -27,6 +27,7 @@
 
 struct address_space;
 struct mem_cgroup;
+struct slabobj_ext;
 
 /*
  * Each physical page in the system has a struct page associated with
@@ -235,10 +236,13 @@ struct page {
 	// 内核中引⽤该物理⻚的次数，表⽰该物理⻚的活跃程度
 	atomic_t _refcount;
 
-#ifdef CONFIG_MEMCG
+#if defined(CONFIG_MEMCG) || defined(CONFIG_MEM_ALLOC_PROFILING)
 	union {
+#ifdef CONFIG_MEMCG
 		struct mem_cgroup *mem_cgroup;
-		struct obj_cgroup **obj_cgroups;
+#endif
+		/* Slab: per object memcg and allocation tag, see mm/slab.h */
+		struct slabobj_ext *obj_exts;
 	};
 #endif
 
@@ -409,6 +413,8 @@ struct vm_area_struct {
 
 #ifdef CONFIG_SWAP
 	atomic_long_t swap_readahead_info;
+	/* Distance in pages between the last two swapin faults */
+	int swap_readahead_stride;
 #endif
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
@@ -680,6 +686,19 @@ struct mm_struct {
 #endif
 		struct work_struct async_put_work;
 
+#ifdef CONFIG_KSM
+		/*
+		 * Represent how many pages of this process are involved in KSM
+		 * merging.
+		 */
+		unsigned long ksm_merging_pages;
+		/*
+		 * Represent how many pages are checked for ksm merging
+		 * including merged and not merged.
+		 */
+		unsigned long ksm_rmap_items;
+#endif
+
 #ifdef CONFIG_IOMMU_SUPPORT
 		u32 pasid;
 #endif
@@ -821,6 +821,8 @@ typedef struct pglist_data {
 	wait_queue_head_t kcompactd_wait;
 	// 内存规整进程，每个NUMA节点一个
 	struct task_struct *kcompactd;   
+	/* Per-node proactiveness, -1 to follow vm.compaction_proactiveness */
+	int compaction_proactiveness;
 #endif
 	/*
 	 * This is a per-node reserve of pages that are not available
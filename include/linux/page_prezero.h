@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __LINUX_PAGE_PREZERO_H
+#define __LINUX_PAGE_PREZERO_H
+
+#include <linux/gfp.h>
+#include <linux/jump_label.h>
+
+struct vm_area_struct;
+
+#ifdef CONFIG_PAGE_PREZERO
+DECLARE_STATIC_KEY_FALSE(page_prezero_enabled);
+
+extern struct page *__prezero_alloc_pages(gfp_t gfp_mask, unsigned int order,
+					  int nid, nodemask_t *nodemask);
+extern struct page *prezero_alloc_vma(gfp_t gfp_mask,
+				      struct vm_area_struct *vma,
+				      unsigned int order);
+
+/*
+ * Hand out a page that was cleared in the background by kprezerod, if
+ * the pool of @nid has one.  Returns NULL if the caller must allocate
+ * and clear the page itself.
+ */
+static inline struct page *prezero_alloc_pages(gfp_t gfp_mask,
+					       unsigned int order, int nid,
+					       nodemask_t *nodemask)
+{
+	if (static_branch_unlikely(&page_prezero_enabled))
+		return __prezero_alloc_pages(gfp_mask, order, nid, nodemask);
+	return NULL;
+}
+#else
+static inline struct page *prezero_alloc_pages(gfp_t gfp_mask,
+					       unsigned int order, int nid,
+					       nodemask_t *nodemask)
+{
+	return NULL;
+}
+
+static inline struct page *prezero_alloc_vma(gfp_t gfp_mask,
+					     struct vm_area_struct *vma,
+					     unsigned int order)
+{
+	return NULL;
+}
+#endif /* CONFIG_PAGE_PREZERO */
+
+#endif /* __LINUX_PAGE_PREZERO_H */
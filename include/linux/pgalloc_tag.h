@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Page allocator side of allocation profiling: the alloc_tag of the call
+ * site that allocated a page is kept in its page_ext.
+ */
+#ifndef _LINUX_PGALLOC_TAG_H
+#define _LINUX_PGALLOC_TAG_H
+
+#include <linux/alloc_tag.h>
+#include <linux/sched.h>
+
+struct page;
+
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+extern struct page_ext_operations page_alloc_tagging_ops;
+
+extern void __pgalloc_tag_add(struct page *page, struct alloc_tag *tag,
+			      unsigned int nr);
+extern void __pgalloc_tag_sub(struct page *page, unsigned int nr);
+extern void __pgalloc_tag_sub_pages(struct page *page, unsigned int nr);
+extern void __pgalloc_tag_split(struct page *page, unsigned int nr);
+extern void __pgalloc_tag_swap(struct page *newpage, struct page *oldpage);
+
+/* Charge @nr pages starting at @page to the tag of the current task */
+static inline void pgalloc_tag_add(struct page *page, unsigned int nr)
+{
+	if (mem_alloc_profiling_enabled() && current->alloc_tag)
+		__pgalloc_tag_add(page, current->alloc_tag, nr);
+}
+
+static inline void pgalloc_tag_sub(struct page *page, unsigned int nr)
+{
+	if (mem_alloc_profiling_enabled())
+		__pgalloc_tag_sub(page, nr);
+}
+
+/*
+ * The head @page of a non-compound high order allocation is kept while
+ * its other pages are freed: uncharge their bytes but not the call.
+ */
+static inline void pgalloc_tag_sub_pages(struct page *page, unsigned int nr)
+{
+	if (mem_alloc_profiling_enabled())
+		__pgalloc_tag_sub_pages(page, nr);
+}
+
+static inline void pgalloc_tag_split(struct page *page, unsigned int nr)
+{
+	if (mem_alloc_profiling_enabled())
+		__pgalloc_tag_split(page, nr);
+}
+
+static inline void pgalloc_tag_swap(struct page *newpage, struct page *oldpage)
+{
+	if (mem_alloc_profiling_enabled())
+		__pgalloc_tag_swap(newpage, oldpage);
+}
+#else
+static inline void pgalloc_tag_add(struct page *page, unsigned int nr)
+{
+}
+static inline void pgalloc_tag_sub(struct page *page, unsigned int nr)
+{
+}
+static inline void pgalloc_tag_sub_pages(struct page *page, unsigned int nr)
+{
+}
+static inline void pgalloc_tag_split(struct page *page, unsigned int nr)
+{
+}
+static inline void pgalloc_tag_swap(struct page *newpage, struct page *oldpage)
+{
+}
+#endif /* CONFIG_MEM_ALLOC_PROFILING */
+
+#endif /* _LINUX_PGALLOC_TAG_H */
@@ -36,6 +36,7 @@
 #include <linux/kcsan.h>
 
 /* task_struct member predeclarations (sorted alphabetically): */
+struct alloc_tag;
 struct audit_context;
 struct backing_dev_info;
 struct bio_list;
@@ -1339,6 +1340,11 @@ struct task_struct {
 	struct mem_cgroup		*active_memcg;
 #endif
 
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+	/* Call site charged for the allocations of this task: */
+	struct alloc_tag		*alloc_tag;
+#endif
+
 #ifdef CONFIG_BLK_CGROUP
 	struct request_queue		*throttle_queue;
 #endif
@@ -2121,4 +2127,28 @@ int sched_trace_rq_nr_running(struct rq *rq);
 
 const struct cpumask *sched_trace_rd_span(struct root_domain *rd);
 
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+static __always_inline struct alloc_tag *alloc_tag_save(struct alloc_tag *tag)
+{
+	struct alloc_tag *old = current->alloc_tag;
+
+	current->alloc_tag = tag;
+	return old;
+}
+
+static __always_inline void alloc_tag_restore(struct alloc_tag *old)
+{
+	current->alloc_tag = old;
+}
+#else
+static __always_inline struct alloc_tag *alloc_tag_save(struct alloc_tag *tag)
+{
+	return NULL;
+}
+
+static __always_inline void alloc_tag_restore(struct alloc_tag *old)
+{
+}
+#endif
+
 #endif
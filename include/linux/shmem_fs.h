@@ -23,6 +23,7 @@ struct shmem_inode_info {
 	struct shared_policy	policy;		/* NUMA memory alloc policy */
 	struct simple_xattrs	xattrs;		/* list of xattrs */
 	atomic_t		stop_eviction;	/* hold when working on inode */
+	struct user_struct	*nosplit_user;	/* charged for F_SEAL_NOSPLIT */
 	struct inode		vfs_inode;
 };
 
@@ -68,11 +69,21 @@ extern unsigned long shmem_get_unmapped_area(struct file *, unsigned long addr,
 extern int shmem_lock(struct file *file, int lock, struct user_struct *user);
 #ifdef CONFIG_SHMEM
 extern bool shmem_mapping(struct address_space *mapping);
+extern int shmem_file_set_hugepage(struct file *file);
+extern int shmem_seal_nosplit(struct file *file, unsigned int seals);
 #else
 static inline bool shmem_mapping(struct address_space *mapping)
 {
 	return false;
 }
+static inline int shmem_file_set_hugepage(struct file *file)
+{
+	return -EINVAL;
+}
+static inline int shmem_seal_nosplit(struct file *file, unsigned int seals)
+{
+	return -EINVAL;
+}
 #endif /* CONFIG_SHMEM */
 extern void shmem_unlock_mapping(struct address_space *mapping);
 extern struct page *shmem_read_mapping_page_gfp(struct address_space *mapping,
@@ -115,6 +126,17 @@ static inline bool shmem_file(struct file *file)
 	return shmem_mapping(file->f_mapping);
 }
 
+/*
+ * F_SEAL_NOSPLIT: the huge pages of the file stay huge until they are
+ * freed.  Not while the inode is evicted, which frees them all anyway.
+ */
+static inline bool shmem_mapping_nosplit(struct address_space *mapping)
+{
+	return shmem_mapping(mapping) &&
+	       (SHMEM_I(mapping->host)->seals & F_SEAL_NOSPLIT) &&
+	       !(mapping->host->i_state & I_FREEING);
+}
+
 extern bool shmem_charge(struct inode *inode, long pages);
 extern void shmem_uncharge(struct inode *inode, long pages);
 
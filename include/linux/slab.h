@@ -404,7 +404,8 @@ static __always_inline unsigned int kmalloc_index(size_t size)
 #endif /* !CONFIG_SLOB */
 
 void *__kmalloc(size_t size, gfp_t flags) __assume_kmalloc_alignment __malloc;
-void *kmem_cache_alloc(struct kmem_cache *, gfp_t flags) __assume_slab_alignment __malloc;
+void *kmem_cache_alloc_noprof(struct kmem_cache *, gfp_t flags) __assume_slab_alignment __malloc;
+#define kmem_cache_alloc(...)	alloc_hooks(kmem_cache_alloc_noprof(__VA_ARGS__))
 void kmem_cache_free(struct kmem_cache *, void *);
 
 /*
@@ -428,18 +429,19 @@ static __always_inline void kfree_bulk(size_t size, void **p)
 
 #ifdef CONFIG_NUMA
 void *__kmalloc_node(size_t size, gfp_t flags, int node) __assume_kmalloc_alignment __malloc;
-void *kmem_cache_alloc_node(struct kmem_cache *, gfp_t flags, int node) __assume_slab_alignment __malloc;
+void *kmem_cache_alloc_node_noprof(struct kmem_cache *, gfp_t flags, int node) __assume_slab_alignment __malloc;
 #else
 static __always_inline void *__kmalloc_node(size_t size, gfp_t flags, int node)
 {
 	return __kmalloc(size, flags);
 }
 
-static __always_inline void *kmem_cache_alloc_node(struct kmem_cache *s, gfp_t flags, int node)
+static __always_inline void *kmem_cache_alloc_node_noprof(struct kmem_cache *s, gfp_t flags, int node)
 {
-	return kmem_cache_alloc(s, flags);
+	return kmem_cache_alloc_noprof(s, flags);
 }
 #endif
+#define kmem_cache_alloc_node(...)	alloc_hooks(kmem_cache_alloc_node_noprof(__VA_ARGS__))
 
 #ifdef CONFIG_TRACING
 extern void *kmem_cache_alloc_trace(struct kmem_cache *, gfp_t, size_t) __assume_slab_alignment __malloc;
@@ -462,7 +464,7 @@ kmem_cache_alloc_node_trace(struct kmem_cache *s,
 static __always_inline void *kmem_cache_alloc_trace(struct kmem_cache *s,
 		gfp_t flags, size_t size)
 {
-	void *ret = kmem_cache_alloc(s, flags);
+	void *ret = kmem_cache_alloc_noprof(s, flags);
 
 	ret = kasan_kmalloc(s, ret, size, flags);
 	return ret;
@@ -473,7 +475,7 @@ kmem_cache_alloc_node_trace(struct kmem_cache *s,
 			      gfp_t gfpflags,
 			      int node, size_t size)
 {
-	void *ret = kmem_cache_alloc_node(s, gfpflags, node);
+	void *ret = kmem_cache_alloc_node_noprof(s, gfpflags, node);
 
 	ret = kasan_kmalloc(s, ret, size, gfpflags);
 	return ret;
@@ -553,7 +555,7 @@ static __always_inline void *kmalloc_large(size_t size, gfp_t flags)
  *	eventually.
  */
 // 分配一段物理内存连续的内存
-static __always_inline void *kmalloc(size_t size, gfp_t flags)
+static __always_inline void *kmalloc_noprof(size_t size, gfp_t flags)
 {
 	if (__builtin_constant_p(size)) {
 #ifndef CONFIG_SLOB
@@ -574,8 +576,10 @@ static __always_inline void *kmalloc(size_t size, gfp_t flags)
 	}
 	return __kmalloc(size, flags);
 }
+#define kmalloc(...)		alloc_hooks(kmalloc_noprof(__VA_ARGS__))
+
 // 在指定的节点上分配一块内存
-static __always_inline void *kmalloc_node(size_t size, gfp_t flags, int node)
+static __always_inline void *kmalloc_node_noprof(size_t size, gfp_t flags, int node)
 {
 #ifndef CONFIG_SLOB
 	if (__builtin_constant_p(size) &&
@@ -592,6 +596,7 @@ static __always_inline void *kmalloc_node(size_t size, gfp_t flags, int node)
 #endif
 	return __kmalloc_node(size, flags, node);
 }
+#define kmalloc_node(...)	alloc_hooks(kmalloc_node_noprof(__VA_ARGS__))
 
 /**
  * kmalloc_array - allocate memory for an array.
@@ -599,16 +604,17 @@ static __always_inline void *kmalloc_node(size_t size, gfp_t flags, int node)
  * @size: element size.
  * @flags: the type of memory to allocate (see kmalloc).
  */
-static inline void *kmalloc_array(size_t n, size_t size, gfp_t flags)
+static inline void *kmalloc_array_noprof(size_t n, size_t size, gfp_t flags)
 {
 	size_t bytes;
 
 	if (unlikely(check_mul_overflow(n, size, &bytes)))
 		return NULL;
 	if (__builtin_constant_p(n) && __builtin_constant_p(size))
-		return kmalloc(bytes, flags);
+		return kmalloc_noprof(bytes, flags);
 	return __kmalloc(bytes, flags);
 }
+#define kmalloc_array(...)	alloc_hooks(kmalloc_array_noprof(__VA_ARGS__))
 
 /**
  * kcalloc - allocate memory for an array. The memory is set to zero.
@@ -616,10 +622,11 @@ static inline void *kmalloc_array(size_t n, size_t size, gfp_t flags)
  * @size: element size.
  * @flags: the type of memory to allocate (see kmalloc).
  */
-static inline void *kcalloc(size_t n, size_t size, gfp_t flags)
+static inline void *kcalloc_noprof(size_t n, size_t size, gfp_t flags)
 {
-	return kmalloc_array(n, size, flags | __GFP_ZERO);
+	return kmalloc_array_noprof(n, size, flags | __GFP_ZERO);
 }
+#define kcalloc(...)		alloc_hooks(kcalloc_noprof(__VA_ARGS__))
 
 /*
  * kmalloc_track_caller is a special version of kmalloc that records the
@@ -631,31 +638,34 @@ static inline void *kcalloc(size_t n, size_t size, gfp_t flags)
  */
 extern void *__kmalloc_track_caller(size_t, gfp_t, unsigned long);
 #define kmalloc_track_caller(size, flags) \
-	__kmalloc_track_caller(size, flags, _RET_IP_)
+	alloc_hooks(__kmalloc_track_caller(size, flags, _RET_IP_))
 
-static inline void *kmalloc_array_node(size_t n, size_t size, gfp_t flags,
-				       int node)
+static inline void *kmalloc_array_node_noprof(size_t n, size_t size,
+					      gfp_t flags, int node)
 {
 	size_t bytes;
 
 	if (unlikely(check_mul_overflow(n, size, &bytes)))
 		return NULL;
 	if (__builtin_constant_p(n) && __builtin_constant_p(size))
-		return kmalloc_node(bytes, flags, node);
+		return kmalloc_node_noprof(bytes, flags, node);
 	return __kmalloc_node(bytes, flags, node);
 }
+#define kmalloc_array_node(...)	alloc_hooks(kmalloc_array_node_noprof(__VA_ARGS__))
 
-static inline void *kcalloc_node(size_t n, size_t size, gfp_t flags, int node)
+static inline void *kcalloc_node_noprof(size_t n, size_t size, gfp_t flags,
+					int node)
 {
-	return kmalloc_array_node(n, size, flags | __GFP_ZERO, node);
+	return kmalloc_array_node_noprof(n, size, flags | __GFP_ZERO, node);
 }
+#define kcalloc_node(...)	alloc_hooks(kcalloc_node_noprof(__VA_ARGS__))
 
 
 #ifdef CONFIG_NUMA
 extern void *__kmalloc_node_track_caller(size_t, gfp_t, int, unsigned long);
 #define kmalloc_node_track_caller(size, flags, node) \
-	__kmalloc_node_track_caller(size, flags, node, \
-			_RET_IP_)
+	alloc_hooks(__kmalloc_node_track_caller(size, flags, node, \
+			_RET_IP_))
 
 #else /* CONFIG_NUMA */
 
@@ -667,20 +677,22 @@ extern void *__kmalloc_node_track_caller(size_t, gfp_t, int, unsigned long);
 /*
  * Shortcuts
  */
-static inline void *kmem_cache_zalloc(struct kmem_cache *k, gfp_t flags)
+static inline void *kmem_cache_zalloc_noprof(struct kmem_cache *k, gfp_t flags)
 {
-	return kmem_cache_alloc(k, flags | __GFP_ZERO);
+	return kmem_cache_alloc_noprof(k, flags | __GFP_ZERO);
 }
+#define kmem_cache_zalloc(...)	alloc_hooks(kmem_cache_zalloc_noprof(__VA_ARGS__))
 
 /**
  * kzalloc - allocate memory. The memory is set to zero.
  * @size: how many bytes of memory are required.
  * @flags: the type of memory to allocate (see kmalloc).
  */
-static inline void *kzalloc(size_t size, gfp_t flags)
+static inline void *kzalloc_noprof(size_t size, gfp_t flags)
 {
-	return kmalloc(size, flags | __GFP_ZERO);
+	return kmalloc_noprof(size, flags | __GFP_ZERO);
 }
+#define kzalloc(...)		alloc_hooks(kzalloc_noprof(__VA_ARGS__))
 
 /**
  * kzalloc_node - allocate zeroed memory from a particular memory node.
@@ -688,10 +700,11 @@ static inline void *kzalloc(size_t size, gfp_t flags)
  * @flags: the type of memory to allocate (see kmalloc).
  * @node: memory node from which to allocate
  */
-static inline void *kzalloc_node(size_t size, gfp_t flags, int node)
+static inline void *kzalloc_node_noprof(size_t size, gfp_t flags, int node)
 {
-	return kmalloc_node(size, flags | __GFP_ZERO, node);
+	return kmalloc_node_noprof(size, flags | __GFP_ZERO, node);
 }
+#define kzalloc_node(...)	alloc_hooks(kzalloc_node_noprof(__VA_ARGS__))
 
 unsigned int kmem_cache_size(struct kmem_cache *s);
 void __init kmem_cache_init_late(void);
@@ -311,10 +311,14 @@ struct swap_info_struct {
 #define SWAP_RA_PTE_CACHE_SIZE	(1 << SWAP_RA_ORDER_CEILING)
 #endif
 
+/* Largest fault stride, in pages, that VMA readahead follows */
+#define SWAP_RA_STRIDE_MAX	16
+
 struct vma_swap_readahead {
 	unsigned short win;
 	unsigned short offset;
 	unsigned short nr_pte;
+	unsigned short stride;	/* step between entries in ptes */
 #ifdef CONFIG_64BIT
 	pte_t *ptes;
 #else
@@ -373,6 +377,12 @@ extern unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 						  unsigned long nr_pages,
 						  gfp_t gfp_mask,
 						  bool may_swap);
+extern unsigned long try_to_free_mem_cgroup_pages_nodemask(struct mem_cgroup *memcg,
+						  unsigned long nr_pages,
+						  gfp_t gfp_mask,
+						  bool may_swap,
+						  int *swappiness,
+						  nodemask_t *nodemask);
 extern unsigned long mem_cgroup_shrink_node(struct mem_cgroup *mem,
 						gfp_t gfp_mask, bool noswap,
 						pg_data_t *pgdat,
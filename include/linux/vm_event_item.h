@@ -48,6 +48,11 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PAGEOUTRUN, PGROTATED,
 		DROP_PAGECACHE, DROP_SLAB,
 		OOM_KILL,
+		DIRTY_PAUSE_4MS,	/* balance_dirty_pages() sleeps, by length */
+		DIRTY_PAUSE_16MS,
+		DIRTY_PAUSE_64MS,
+		DIRTY_PAUSE_LONG,
+		DIRTY_PAUSE_MS,		/* total time slept, in ms */
 #ifdef CONFIG_NUMA_BALANCING
 		NUMA_PTE_UPDATES,
 		NUMA_HUGE_PTE_UPDATES,
@@ -67,6 +72,10 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
 		KCOMPACTD_WAKE,
 		KCOMPACTD_MIGRATE_SCANNED, KCOMPACTD_FREE_SCANNED,
+		KCOMPACTD_PROACTIVE_WAKE,
+		KCOMPACTD_PROACTIVE_MIGRATE_SCANNED,
+		KCOMPACTD_PROACTIVE_FREE_SCANNED,
+		KCOMPACTD_PROACTIVE_THROTTLED,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -120,6 +129,18 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_SWAP
 		SWAP_RA,
 		SWAP_RA_HIT,
+#endif
+#ifdef CONFIG_MMU
+		MREMAP_MOVE_PUD,	/* page tables moved by mremap() ... */
+		MREMAP_MOVE_PMD,	/* ... at the pud and pmd level */
+		MREMAP_MOVE_PTE,	/* pte tables moved entry by entry */
+		MREMAP_TLB_FLUSH,	/* TLB flushes issued for moved ranges */
+#endif
+#ifdef CONFIG_PAGE_PREZERO
+		PREZERO_ALLOC,
+		PREZERO_ALLOC_HUGE,
+		PREZERO_FILL,
+		PREZERO_DRAIN,
 #endif
 		NR_VM_EVENT_ITEMS
 };
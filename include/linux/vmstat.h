@@ -11,6 +11,7 @@
 #include <linux/mmdebug.h>
 
 extern int sysctl_stat_interval;
+extern int sysctl_stat_nohz_full_quiet;
 
 #ifdef CONFIG_NUMA
 #define ENABLE_NUMA_STAT   1
@@ -284,9 +285,13 @@ extern void __dec_zone_state(struct zone *, enum zone_stat_item);
 extern void __dec_node_state(struct pglist_data *, enum node_stat_item);
 
 void quiet_vmstat(void);
+bool vmstat_quiet_cpu(int cpu);
 void cpu_vm_stats_fold(int cpu);
 void refresh_zone_stat_thresholds(void);
 
+unsigned long global_zone_page_state_snapshot(enum zone_stat_item item);
+unsigned long global_node_page_state_snapshot(enum node_stat_item item);
+
 struct ctl_table;
 int vmstat_refresh(struct ctl_table *, int write, void *buffer, size_t *lenp,
 		loff_t *ppos);
@@ -391,6 +396,19 @@ static inline void __dec_node_page_state(struct page *page,
 static inline void refresh_zone_stat_thresholds(void) { }
 static inline void cpu_vm_stats_fold(int cpu) { }
 static inline void quiet_vmstat(void) { }
+static inline bool vmstat_quiet_cpu(int cpu) { return false; }
+
+static inline unsigned long
+global_zone_page_state_snapshot(enum zone_stat_item item)
+{
+	return global_zone_page_state(item);
+}
+
+static inline unsigned long
+global_node_page_state_snapshot(enum node_stat_item item)
+{
+	return global_node_page_state_pages(item);
+}
 
 static inline void drain_zonestat(struct zone *zone,
 			struct per_cpu_pageset *pset) { }
@@ -8,6 +8,7 @@
 #include <linux/types.h>
 #include <linux/tracepoint.h>
 #include <linux/mm.h>
+#include <linux/pagemap.h>
 #include <linux/memcontrol.h>
 #include <linux/device.h>
 #include <linux/kdev_t.h>
@@ -110,6 +111,62 @@ TRACE_EVENT(file_check_and_advance_wb_err,
 			MINOR(__entry->s_dev), __entry->i_ino, __entry->old,
 			__entry->new)
 );
+
+DECLARE_EVENT_CLASS(mm_filemap_readahead,
+
+	TP_PROTO(struct readahead_control *ractl, struct file_ra_state *ra,
+		 unsigned long req_count),
+
+	TP_ARGS(ractl, ra, req_count),
+
+	TP_STRUCT__entry(
+		__field(struct file *, file)
+		__field(unsigned long, i_ino)
+		__field(dev_t, s_dev)
+		__field(pgoff_t, index)
+		__field(unsigned long, req_count)
+		__field(pgoff_t, start)
+		__field(unsigned int, size)
+		__field(unsigned int, async_size)
+		__field(unsigned int, ra_pages)
+	),
+
+	TP_fast_assign(
+		__entry->file = ractl->file;
+		__entry->i_ino = ractl->mapping->host->i_ino;
+		if (ractl->mapping->host->i_sb)
+			__entry->s_dev = ractl->mapping->host->i_sb->s_dev;
+		else
+			__entry->s_dev = ractl->mapping->host->i_rdev;
+		__entry->index = readahead_index(ractl);
+		__entry->req_count = req_count;
+		__entry->start = ra->start;
+		__entry->size = ra->size;
+		__entry->async_size = ra->async_size;
+		__entry->ra_pages = ra->ra_pages;
+	),
+
+	TP_printk("file=%p dev=%d:%d ino=0x%lx index=%lu req=%lu start=%lu size=%u async_size=%u max=%u",
+		__entry->file, MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino, __entry->index, __entry->req_count,
+		__entry->start, __entry->size, __entry->async_size,
+		__entry->ra_pages)
+);
+
+/* A read missed the page cache and had to wait for synchronous readahead */
+DEFINE_EVENT(mm_filemap_readahead, mm_filemap_readahead_miss,
+	TP_PROTO(struct readahead_control *ractl, struct file_ra_state *ra,
+		 unsigned long req_count),
+	TP_ARGS(ractl, ra, req_count)
+	);
+
+/* A read reached a readahead marker page, readahead is ahead of it */
+DEFINE_EVENT(mm_filemap_readahead, mm_filemap_readahead_hit,
+	TP_PROTO(struct readahead_control *ractl, struct file_ra_state *ra,
+		 unsigned long req_count),
+	TP_ARGS(ractl, ra, req_count)
+	);
+
 #endif /* _TRACE_FILEMAP_H */
 
 /* This part must be outside protection */
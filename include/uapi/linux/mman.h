@@ -9,6 +9,12 @@
 #define MREMAP_FIXED		2
 #define MREMAP_DONTUNMAP	4
 
+/*
+ * process_madvise() flags: advise every range even if some of them fail,
+ * and write the number of bytes advised in each range back to its iov_len.
+ */
+#define PMADV_PER_RANGE		0x01
+
 #define OVERCOMMIT_GUESS		0
 #define OVERCOMMIT_ALWAYS		1
 #define OVERCOMMIT_NEVER		2
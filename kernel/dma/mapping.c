@@ -485,8 +485,8 @@ struct page *dma_alloc_pages(struct device *dev, size_t size,
 	size = PAGE_ALIGN(size);
 	if (dma_alloc_direct(dev, ops))
 		page = dma_direct_alloc_pages(dev, size, dma_handle, dir, gfp);
-	else if (ops->alloc_pages)
-		page = ops->alloc_pages(dev, size, dma_handle, dir, gfp);
+	else if (ops->alloc_pages_op)
+		page = ops->alloc_pages_op(dev, size, dma_handle, dir, gfp);
 	else
 		return NULL;
 
@@ -4,6 +4,7 @@
 #include <linux/entry-common.h>
 #include <linux/livepatch.h>
 #include <linux/audit.h>
+#include <linux/vmstat.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/syscalls.h>
@@ -192,6 +193,10 @@ static void exit_to_user_mode_prepare(struct pt_regs *regs)
 
 	arch_exit_to_user_mode_prepare(regs, ti_work);
 
+	/* Fold the vmstat counters here rather than in a worker later on */
+	if (vmstat_quiet_cpu(smp_processor_id()))
+		quiet_vmstat();
+
 	/* Ensure that the address limit is intact and no locks are held */
 	addr_limit_user_check();
 	lockdep_assert_irqs_disabled();
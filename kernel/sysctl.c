@@ -42,6 +42,8 @@
 #include <linux/writeback.h>
 #include <linux/ratelimit.h>
 #include <linux/compaction.h>
+#include <linux/migrate.h>
+#include <linux/alloc_tag.h>
 #include <linux/hugetlb.h>
 #include <linux/initrd.h>
 #include <linux/key.h>
@@ -200,6 +202,10 @@ static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
 #endif
 
+#ifdef CONFIG_MIGRATION
+static int max_migrate_copy_threads = 32;
+#endif
+
 #endif /* CONFIG_SYSCTL */
 
 #if defined(CONFIG_BPF_SYSCALL) && defined(CONFIG_SYSCTL)
@@ -2787,6 +2793,15 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= SYSCTL_ZERO,
 	},
+	{
+		.procname	= "dirty_max_pause_ms",
+		.data		= &dirty_max_pause_ms,
+		.maxlen		= sizeof(dirty_max_pause_ms),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ONE,
+		.extra2		= &two_hundred,
+	},
 	{
 		.procname	= "dirtytime_expire_seconds",
 		.data		= &dirtytime_expire_interval,
@@ -2878,6 +2893,15 @@ static struct ctl_table vm_table[] = {
 		.extra1		= SYSCTL_ZERO,
 		.extra2		= &one_hundred,
 	},
+	{
+		.procname	= "compaction_proactive_budget",
+		.data		= &sysctl_compaction_proactive_budget,
+		.maxlen		= sizeof(sysctl_compaction_proactive_budget),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ONE,
+		.extra2		= &one_hundred,
+	},
 	{
 		.procname	= "extfrag_threshold",
 		.data		= &sysctl_extfrag_threshold,
@@ -2898,6 +2922,17 @@ static struct ctl_table vm_table[] = {
 	},
 
 #endif /* CONFIG_COMPACTION */
+#ifdef CONFIG_MIGRATION
+	{
+		.procname	= "migrate_copy_threads",
+		.data		= &sysctl_migrate_copy_threads,
+		.maxlen		= sizeof(sysctl_migrate_copy_threads),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ONE,
+		.extra2		= &max_migrate_copy_threads,
+	},
+#endif
 	{
 		.procname	= "min_free_kbytes",
 		.data		= &min_free_kbytes,
@@ -3035,6 +3070,15 @@ static struct ctl_table vm_table[] = {
 		.mode		= 0600,
 		.proc_handler	= vmstat_refresh,
 	},
+	{
+		.procname	= "stat_nohz_full_quiet",
+		.data		= &sysctl_stat_nohz_full_quiet,
+		.maxlen		= sizeof(sysctl_stat_nohz_full_quiet),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
 #endif
 #ifdef CONFIG_MMU
 	{
@@ -3100,6 +3144,15 @@ static struct ctl_table vm_table[] = {
 		.extra1		= SYSCTL_ZERO,
 		.extra2		= SYSCTL_ONE,
 	},
+#endif
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+	{
+		.procname	= "mem_profiling",
+		.data		= &mem_alloc_profiling_key.key,
+		.maxlen		= sizeof(mem_alloc_profiling_key),
+		.mode		= 0644,
+		.proc_handler	= mem_profiling_sysctl_handler,
+	},
 #endif
 	{
 		.procname	= "user_reserve_kbytes",
@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Allocation profiling
+ *
+ * Every call site of the page and slab allocators has a static alloc_tag
+ * in the "alloc_tags" section (see DEFINE_ALLOC_TAG()).  The allocation
+ * wrappers make it the current task's alloc_tag for the duration of the
+ * call, the allocator charges the bytes to it and remembers it in the
+ * page_ext of the page, or in the slabobj_ext vector of the slab page for
+ * slab objects, so that the free can uncharge it again.  /proc/allocinfo lists the bytes
+ * and the number of allocations each call site currently has live.
+ */
+#include <linux/alloc_tag.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/page_ext.h>
+#include <linux/pgalloc_tag.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sysctl.h>
+
+#include "internal.h"
+#include "slab.h"
+
+extern struct alloc_tag __start_alloc_tags[];
+extern struct alloc_tag __stop_alloc_tags[];
+
+#ifdef CONFIG_MEM_ALLOC_PROFILING_ENABLED_BY_DEFAULT
+DEFINE_STATIC_KEY_TRUE(mem_alloc_profiling_key);
+#else
+DEFINE_STATIC_KEY_FALSE(mem_alloc_profiling_key);
+#endif
+
+/* Cleared by mem_profiling=never, which also saves the page_ext space */
+static bool mem_profiling_support __ro_after_init = true;
+
+struct alloc_tag_ref {
+	/* Tag of the allocation that owns the page */
+	struct alloc_tag *tag;
+};
+
+static int __init setup_early_mem_profiling(char *str)
+{
+	bool enable;
+
+	if (!str || !str[0])
+		return -EINVAL;
+
+	if (!strcmp(str, "never")) {
+		enable = false;
+		mem_profiling_support = false;
+	} else if (kstrtobool(str, &enable)) {
+		return -EINVAL;
+	}
+
+	if (enable)
+		static_branch_enable(&mem_alloc_profiling_key);
+	else
+		static_branch_disable(&mem_alloc_profiling_key);
+
+	return 0;
+}
+early_param("mem_profiling", setup_early_mem_profiling);
+
+static bool need_page_alloc_tagging(void)
+{
+	return mem_profiling_support;
+}
+
+struct page_ext_operations page_alloc_tagging_ops = {
+	.size = sizeof(struct alloc_tag_ref),
+	.need = need_page_alloc_tagging,
+};
+
+static inline struct alloc_tag_ref *get_tag_ref(struct page_ext *page_ext)
+{
+	return (void *)page_ext + page_alloc_tagging_ops.offset;
+}
+
+static struct alloc_tag_ref *lookup_tag_ref(struct page *page)
+{
+	struct page_ext *page_ext = lookup_page_ext(page);
+
+	if (unlikely(!page_ext))
+		return NULL;
+
+	return get_tag_ref(page_ext);
+}
+
+static inline void alloc_tag_add(struct alloc_tag *tag, size_t bytes)
+{
+	this_cpu_add(tag->counters->bytes, bytes);
+	this_cpu_inc(tag->counters->calls);
+}
+
+static inline void alloc_tag_sub(struct alloc_tag *tag, size_t bytes)
+{
+	this_cpu_sub(tag->counters->bytes, bytes);
+	this_cpu_dec(tag->counters->calls);
+}
+
+void __pgalloc_tag_add(struct page *page, struct alloc_tag *tag,
+		       unsigned int nr)
+{
+	struct alloc_tag_ref *ref = lookup_tag_ref(page);
+
+	if (unlikely(!ref))
+		return;
+
+	ref->tag = tag;
+	alloc_tag_add(tag, PAGE_SIZE * nr);
+}
+
+void __pgalloc_tag_sub(struct page *page, unsigned int nr)
+{
+	struct alloc_tag_ref *ref = lookup_tag_ref(page);
+	struct alloc_tag *tag;
+
+	if (unlikely(!ref) || !ref->tag)
+		return;
+
+	tag = ref->tag;
+	ref->tag = NULL;
+	alloc_tag_sub(tag, PAGE_SIZE * nr);
+}
+
+void __pgalloc_tag_sub_pages(struct page *page, unsigned int nr)
+{
+	struct alloc_tag_ref *ref = lookup_tag_ref(page);
+
+	if (unlikely(!ref) || !ref->tag)
+		return;
+
+	this_cpu_sub(ref->tag->counters->bytes, PAGE_SIZE * nr);
+}
+
+/*
+ * The @nr pages of a high order allocation become independent pages, each
+ * of which is going to be freed, and uncharged, on its own.
+ */
+void __pgalloc_tag_split(struct page *page, unsigned int nr)
+{
+	struct page_ext *page_ext = lookup_page_ext(page);
+	struct alloc_tag *tag;
+	unsigned int i;
+
+	if (unlikely(!page_ext))
+		return;
+
+	tag = get_tag_ref(page_ext)->tag;
+	if (!tag)
+		return;
+
+	for (i = 1; i < nr; i++) {
+		page_ext = page_ext_next(page_ext);
+		get_tag_ref(page_ext)->tag = tag;
+	}
+	this_cpu_add(tag->counters->calls, nr - 1);
+}
+
+/*
+ * @newpage replaces @oldpage: keep the charge on the call site that
+ * allocated @oldpage, and have the free of @oldpage uncharge the one
+ * that allocated @newpage.
+ */
+void __pgalloc_tag_swap(struct page *newpage, struct page *oldpage)
+{
+	struct alloc_tag_ref *new_ref = lookup_tag_ref(newpage);
+	struct alloc_tag_ref *old_ref = lookup_tag_ref(oldpage);
+
+	if (unlikely(!new_ref || !old_ref))
+		return;
+
+	swap(new_ref->tag, old_ref->tag);
+}
+
+void __alloc_tagging_slab_alloc_hook(struct kmem_cache *s, void *object,
+				     gfp_t flags)
+{
+	struct page *page = virt_to_head_page(object);
+	struct alloc_tag *tag = current->alloc_tag;
+
+	if (!page_has_obj_exts(page) &&
+	    alloc_page_obj_exts(page, s, (flags & GFP_RECLAIM_MASK &
+					  ~__GFP_NOFAIL) | __GFP_NOWARN))
+		return;
+
+	page_obj_exts(page)[obj_to_index(s, page, object)].tag = tag;
+	alloc_tag_add(tag, s->size);
+}
+
+void __alloc_tagging_slab_free_hook(struct kmem_cache *s, void *object)
+{
+	struct page *page = virt_to_head_page(object);
+	struct slabobj_ext *ext;
+
+	if (!page_has_obj_exts(page))
+		return;
+
+	ext = &page_obj_exts(page)[obj_to_index(s, page, object)];
+	if (!ext->tag)
+		return;
+
+	alloc_tag_sub(ext->tag, s->size);
+	ext->tag = NULL;
+}
+
+#ifdef CONFIG_SYSCTL
+int mem_profiling_sysctl_handler(struct ctl_table *table, int write,
+				 void *buffer, size_t *lenp, loff_t *ppos)
+{
+	if (write && !mem_profiling_support)
+		return -EOPNOTSUPP;
+
+	return proc_do_static_key(table, write, buffer, lenp, ppos);
+}
+#endif
+
+#ifdef CONFIG_PROC_FS
+static struct alloc_tag *nth_tag(loff_t n)
+{
+	if (n >= __stop_alloc_tags - __start_alloc_tags)
+		return NULL;
+
+	return __start_alloc_tags + n;
+}
+
+static void *allocinfo_start(struct seq_file *m, loff_t *pos)
+{
+	if (!*pos) {
+		seq_puts(m, "allocinfo - version: 1.0\n");
+		seq_puts(m, "#     <size>  <calls> <tag info>\n");
+	}
+
+	return nth_tag(*pos);
+}
+
+static void *allocinfo_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return nth_tag(++*pos);
+}
+
+static void allocinfo_stop(struct seq_file *m, void *v)
+{
+}
+
+static int allocinfo_show(struct seq_file *m, void *v)
+{
+	struct alloc_tag *tag = v;
+	u64 bytes = 0, calls = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct alloc_tag_counters *counters;
+
+		counters = per_cpu_ptr(tag->counters, cpu);
+		bytes += counters->bytes;
+		calls += counters->calls;
+	}
+
+	seq_printf(m, "%12llu %8llu %s:%u func:%s\n", bytes, calls,
+		   tag->filename, tag->lineno, tag->function);
+
+	return 0;
+}
+
+static const struct seq_operations allocinfo_seq_op = {
+	.start	= allocinfo_start,
+	.next	= allocinfo_next,
+	.stop	= allocinfo_stop,
+	.show	= allocinfo_show,
+};
+
+static int __init alloc_tag_init(void)
+{
+	if (mem_profiling_support)
+		proc_create_seq("allocinfo", 0400, NULL, &allocinfo_seq_op);
+
+	return 0;
+}
+module_init(alloc_tag_init);
+#endif /* CONFIG_PROC_FS */
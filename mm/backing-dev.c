@@ -198,6 +198,26 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+static ssize_t writeback_workers_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	unsigned int workers;
+	ssize_t ret;
+
+	ret = kstrtouint(buf, 10, &workers);
+	if (ret < 0)
+		return ret;
+
+	if (!workers || workers > WB_MAX_WORKERS)
+		return -EINVAL;
+
+	WRITE_ONCE(bdi->wb_workers, workers);
+
+	return count;
+}
+BDI_SHOW(writeback_workers, READ_ONCE(bdi->wb_workers))
+
 static ssize_t stable_pages_required_show(struct device *dev,
 					  struct device_attribute *attr,
 					  char *page)
@@ -212,6 +232,7 @@ static struct attribute *bdi_dev_attrs[] = {
 	&dev_attr_read_ahead_kb.attr,
 	&dev_attr_min_ratio.attr,
 	&dev_attr_max_ratio.attr,
+	&dev_attr_writeback_workers.attr,
 	&dev_attr_stable_pages_required.attr,
 	NULL,
 };
@@ -722,6 +743,7 @@ static int bdi_init(struct backing_dev_info *bdi)
 	bdi->min_ratio = 0;
 	bdi->max_ratio = 100;
 	bdi->max_prop_frac = FPROP_FRAC_BASE;
+	bdi->wb_workers = 1;
 	INIT_LIST_HEAD(&bdi->bdi_list);
 	INIT_LIST_HEAD(&bdi->wb_list);
 	init_waitqueue_head(&bdi->wb_waitq);
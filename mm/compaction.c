@@ -1928,6 +1928,20 @@ static unsigned int fragmentation_score_node(pg_data_t *pgdat)
 	return score;
 }
 
+/*
+ * The proactiveness of a node: its own setting from the node's
+ * compaction_proactiveness sysfs file, or vm.compaction_proactiveness
+ * if none was set.
+ */
+static unsigned int node_proactiveness(pg_data_t *pgdat)
+{
+	int proactiveness = READ_ONCE(pgdat->compaction_proactiveness);
+
+	if (proactiveness < 0)
+		return READ_ONCE(sysctl_compaction_proactiveness);
+	return proactiveness;
+}
+
 static unsigned int fragmentation_score_wmark(pg_data_t *pgdat, bool low)
 {
 	unsigned int wmark_low;
@@ -1937,7 +1951,7 @@ static unsigned int fragmentation_score_wmark(pg_data_t *pgdat, bool low)
 	 * activity in case a user sets the proactivess tunable
 	 * close to 100 (maximum).
 	 */
-	wmark_low = max(100U - sysctl_compaction_proactiveness, 5U);
+	wmark_low = max(100U - node_proactiveness(pgdat), 5U);
 	return low ? wmark_low : min(wmark_low + 10, 100U);
 }
 
@@ -1945,7 +1959,7 @@ static bool should_proactive_compact_node(pg_data_t *pgdat)
 {
 	int wmark_high;
 
-	if (!sysctl_compaction_proactiveness || kswapd_is_running(pgdat))
+	if (!node_proactiveness(pgdat) || kswapd_is_running(pgdat))
 		return false;
 
 	wmark_high = fragmentation_score_wmark(pgdat, false);
@@ -1986,6 +2000,11 @@ static enum compact_result __compact_finished(struct compact_control *cc)
 		if (kswapd_is_running(pgdat))
 			return COMPACT_PARTIAL_SKIPPED;
 
+		/* Out of CPU budget for this round, kcompactd resumes later */
+		if (cc->proactive_deadline &&
+		    time_after(jiffies, cc->proactive_deadline))
+			return COMPACT_PARTIAL_SKIPPED;
+
 		score = fragmentation_score_zone(cc->zone);
 		wmark_low = fragmentation_score_wmark(pgdat, true);
 
@@ -2545,7 +2564,7 @@ enum compact_result try_to_compact_pages(gfp_t gfp_mask, unsigned int order,
  * due to various back-off conditions, such as, contention on per-node or
  * per-zone locks.
  */
-static void proactive_compact_node(pg_data_t *pgdat)
+static void proactive_compact_node(pg_data_t *pgdat, unsigned long deadline)
 {
 	int zoneid;
 	struct zone *zone;
@@ -2556,17 +2575,28 @@ static void proactive_compact_node(pg_data_t *pgdat)
 		.whole_zone = true,
 		.gfp_mask = GFP_KERNEL,
 		.proactive_compaction = true,
+		.proactive_deadline = deadline,
 	};
 
+	count_compact_event(KCOMPACTD_PROACTIVE_WAKE);
+
 	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
 		zone = &pgdat->node_zones[zoneid];
 		if (!populated_zone(zone))
 			continue;
 
+		if (deadline && time_after(jiffies, deadline))
+			break;
+
 		cc.zone = zone;
 
 		compact_zone(&cc, NULL);
 
+		count_compact_events(KCOMPACTD_PROACTIVE_MIGRATE_SCANNED,
+				     cc.total_migrate_scanned);
+		count_compact_events(KCOMPACTD_PROACTIVE_FREE_SCANNED,
+				     cc.total_free_scanned);
+
 		VM_BUG_ON(!list_empty(&cc.freepages));
 		VM_BUG_ON(!list_empty(&cc.migratepages));
 	}
@@ -2624,6 +2654,13 @@ int sysctl_compact_memory;
  */
 unsigned int __read_mostly sysctl_compaction_proactiveness = 20;
 
+/*
+ * Percentage of a CPU that kcompactd may spend on proactive compaction
+ * of its node, averaged over time. It takes values in the range [1, 100];
+ * 100 does not throttle at all.
+ */
+unsigned int __read_mostly sysctl_compaction_proactive_budget = 100;
+
 /*
  * This is the entry point for compacting all nodes via
  * /proc/sys/vm/compact_memory
@@ -2655,14 +2692,58 @@ static ssize_t sysfs_compact_node(struct device *dev,
 }
 static DEVICE_ATTR(compact, 0200, NULL, sysfs_compact_node);
 
+static ssize_t compaction_proactiveness_show(struct device *dev,
+					     struct device_attribute *attr,
+					     char *buf)
+{
+	return sprintf(buf, "%d\n",
+		       READ_ONCE(NODE_DATA(dev->id)->compaction_proactiveness));
+}
+
+static ssize_t compaction_proactiveness_store(struct device *dev,
+					      struct device_attribute *attr,
+					      const char *buf, size_t count)
+{
+	int val, err;
+
+	err = kstrtoint(buf, 10, &val);
+	if (err)
+		return err;
+	if (val < -1 || val > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(NODE_DATA(dev->id)->compaction_proactiveness, val);
+	return count;
+}
+static DEVICE_ATTR_RW(compaction_proactiveness);
+
+static ssize_t fragmentation_score_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return sprintf(buf, "%u\n", fragmentation_score_node(NODE_DATA(dev->id)));
+}
+static DEVICE_ATTR_RO(fragmentation_score);
+
+static struct attribute *compaction_node_attrs[] = {
+	&dev_attr_compact.attr,
+	&dev_attr_compaction_proactiveness.attr,
+	&dev_attr_fragmentation_score.attr,
+	NULL,
+};
+
+static const struct attribute_group compaction_node_group = {
+	.attrs = compaction_node_attrs,
+};
+
 int compaction_register_node(struct node *node)
 {
-	return device_create_file(&node->dev, &dev_attr_compact);
+	return sysfs_create_group(&node->dev.kobj, &compaction_node_group);
 }
 
 void compaction_unregister_node(struct node *node)
 {
-	return device_remove_file(&node->dev, &dev_attr_compact);
+	sysfs_remove_group(&node->dev.kobj, &compaction_node_group);
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
 
@@ -2805,6 +2886,7 @@ static int kcompactd(void *p)
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
 	unsigned int proactive_defer = 0;
+	unsigned long throttle_until = jiffies;
 
 	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
 
@@ -2832,15 +2914,36 @@ static int kcompactd(void *p)
 
 		/* kcompactd wait timeout */
 		if (should_proactive_compact_node(pgdat)) {
-			unsigned int prev_score, score;
+			unsigned int prev_score, score, budget;
+			unsigned long start, deadline = 0;
 
 			if (proactive_defer) {
 				proactive_defer--;
 				continue;
 			}
+			if (time_before(jiffies, throttle_until)) {
+				count_compact_event(KCOMPACTD_PROACTIVE_THROTTLED);
+				continue;
+			}
+
+			/*
+			 * With a CPU budget, compact for at most one check
+			 * interval at a time and then stay idle long enough
+			 * for the time spent to average out to the budget.
+			 */
+			budget = READ_ONCE(sysctl_compaction_proactive_budget);
+			start = jiffies;
+			if (budget < 100)
+				deadline = start + msecs_to_jiffies(
+					HPAGE_FRAG_CHECK_INTERVAL_MSEC);
+
 			prev_score = fragmentation_score_node(pgdat);
-			proactive_compact_node(pgdat);
+			proactive_compact_node(pgdat, deadline);
 			score = fragmentation_score_node(pgdat);
+
+			if (budget < 100)
+				throttle_until = jiffies + (jiffies - start) *
+						 (100 - budget) / budget;
 			/*
 			 * Defer proactive compaction if the fragmentation
 			 * score did not go down i.e. no progress made.
@@ -676,6 +676,57 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 }
 EXPORT_SYMBOL(filemap_write_and_wait_range);
 
+/*
+ * Uncached (RWF_UNCACHED) I/O is done with @page: drop it from the page
+ * cache, unless somebody else has been using it or it is busy.
+ */
+static void drop_uncached_page(struct address_space *mapping,
+			       struct page *page)
+{
+	if (PageCompound(page) || PageReferenced(page) || PageActive(page) ||
+	    PageDirty(page) || PageWriteback(page) || page_mapped(page))
+		return;
+	if (!trylock_page(page))
+		return;
+	if (page->mapping == mapping)
+		invalidate_inode_page(page);
+	unlock_page(page);
+}
+
+/**
+ * filemap_drop_uncached_range - drop the pages an uncached write left behind
+ * @mapping:	address space structure to drop pages from
+ * @start:	offset in bytes where the range starts
+ * @end:	offset in bytes where the range ends (inclusive)
+ *
+ * Write back the range and wait for it, then drop the pages from the page
+ * cache, except those somebody else has been using in the meantime.
+ *
+ * Return: error status of the writeback, 0 on success.
+ */
+int filemap_drop_uncached_range(struct address_space *mapping,
+				loff_t start, loff_t end)
+{
+	pgoff_t index = start >> PAGE_SHIFT;
+	pgoff_t end_index = end >> PAGE_SHIFT;
+	struct pagevec pvec;
+	int i, err;
+
+	err = filemap_write_and_wait_range(mapping, start, end);
+	if (err)
+		return err;
+
+	pagevec_init(&pvec);
+	while (pagevec_lookup_range(&pvec, mapping, &index, end_index)) {
+		for (i = 0; i < pagevec_count(&pvec); i++)
+			drop_uncached_page(mapping, pvec.pages[i]);
+		pagevec_release(&pvec);
+		cond_resched();
+	}
+	return 0;
+}
+EXPORT_SYMBOL(filemap_drop_uncached_range);
+
 void __filemap_set_wb_err(struct address_space *mapping, int err)
 {
 	errseq_t eseq = errseq_set(&mapping->wb_err, err);
@@ -2338,9 +2389,12 @@ page_ok:
 
 		/*
 		 * When a sequential read accesses a page several times,
-		 * only mark it as accessed the first time.
+		 * only mark it as accessed the first time.  Uncached reads
+		 * don't, so the page is dropped after the copy unless
+		 * somebody else uses it.
 		 */
-		if (prev_index != index || offset != prev_offset)
+		if ((prev_index != index || offset != prev_offset) &&
+		    !(iocb->ki_flags & IOCB_UNCACHED))
 			mark_page_accessed(page);
 		prev_index = index;
 
@@ -2355,6 +2409,9 @@ page_ok:
 		offset &= ~PAGE_MASK;
 		prev_offset = offset;
 
+		/* Done with the page unless the next read continues in it */
+		if ((iocb->ki_flags & IOCB_UNCACHED) && ret == nr)
+			drop_uncached_page(mapping, page);
 		put_page(page);
 		written += ret;
 		if (!iov_iter_count(iter))
@@ -2633,6 +2690,32 @@ static struct file *do_sync_mmap_readahead(struct vm_fault *vmf)
 	/* If we don't want any read-ahead, don't bother */
 	if (vmf->vma->vm_flags & VM_RAND_READ)
 		return fpin;
+
+#ifdef CONFIG_READ_ONLY_THP_FOR_FS
+	/*
+	 * Read the whole PMD-aligned extent around the fault and the next
+	 * one, even if readahead is disabled, so khugepaged finds them
+	 * uptodate in the page cache and can collapse them into THPs without
+	 * issuing more I/O.  Stop when the faults mostly miss, as below.
+	 */
+	if ((vmf->vma->vm_flags & VM_HUGEPAGE) &&
+	    transhuge_vma_suitable(vmf->vma, vmf->address & HPAGE_PMD_MASK)) {
+		mmap_miss = READ_ONCE(ra->mmap_miss);
+		if (mmap_miss < MMAP_LOTSAMISS * 10)
+			WRITE_ONCE(ra->mmap_miss, ++mmap_miss);
+		if (mmap_miss > MMAP_LOTSAMISS)
+			return fpin;
+
+		fpin = maybe_unlock_mmap_for_io(vmf, fpin);
+		ra->start = vmf->pgoff & ~((pgoff_t)HPAGE_PMD_NR - 1);
+		ra->size = 2 * HPAGE_PMD_NR;
+		ra->async_size = HPAGE_PMD_NR;
+		ractl._index = ra->start;
+		do_page_cache_ra(&ractl, ra->size, ra->async_size);
+		return fpin;
+	}
+#endif
+
 	if (!ra->ra_pages)
 		return fpin;
 
@@ -241,6 +241,9 @@ static inline void __frontswap_clear(struct swap_info_struct *sis,
  * If frontswap already contains a page with matching swaptype and
  * offset, the frontswap implementation may either overwrite the data and
  * return success or invalidate the page from frontswap and return failure.
+ *
+ * A THP is passed to the implementations in one piece; they either store
+ * all of its subpages at consecutive offsets or fail the whole store.
  */
 int __frontswap_store(struct page *page)
 {
@@ -250,6 +253,7 @@ int __frontswap_store(struct page *page)
 	struct swap_info_struct *sis = swap_info[type];
 	pgoff_t offset = swp_offset(entry);
 	struct frontswap_ops *ops;
+	int i, nr = thp_nr_pages(page);
 
 	VM_BUG_ON(!frontswap_ops);
 	VM_BUG_ON(!PageLocked(page));
@@ -261,10 +265,12 @@ int __frontswap_store(struct page *page)
 	 * and we can't rely on the new page replacing the old page as we may
 	 * not store to the same implementation that contains the old page.
 	 */
-	if (__frontswap_test(sis, offset)) {
-		__frontswap_clear(sis, offset);
-		for_each_frontswap_ops(ops)
-			ops->invalidate_page(type, offset);
+	for (i = 0; i < nr; i++) {
+		if (__frontswap_test(sis, offset + i)) {
+			__frontswap_clear(sis, offset + i);
+			for_each_frontswap_ops(ops)
+				ops->invalidate_page(type, offset + i);
+		}
 	}
 
 	/* Try to store in each implementation, until one succeeds. */
@@ -274,7 +280,8 @@ int __frontswap_store(struct page *page)
 			break;
 	}
 	if (ret == 0) {
-		__frontswap_set(sis, offset);
+		for (i = 0; i < nr; i++)
+			__frontswap_set(sis, offset + i);
 		inc_frontswap_succ_stores();
 	} else {
 		inc_frontswap_failed_stores();
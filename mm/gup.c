@@ -242,6 +242,37 @@ void unpin_user_page(struct page *page)
 }
 EXPORT_SYMBOL(unpin_user_page);
 
+/*
+ * Find the run of entries of @list starting at @i that belong to the same
+ * compound page, so that they can be released with a single update of its
+ * head page.
+ */
+static inline void compound_next(unsigned long i, unsigned long npages,
+				 struct page **list, struct page **head,
+				 unsigned int *ntails)
+{
+	struct page *page;
+	unsigned int nr;
+
+	if (i >= npages)
+		return;
+
+	page = compound_head(list[i]);
+	for (nr = i + 1; nr < npages; nr++) {
+		if (compound_head(list[nr]) != page)
+			break;
+	}
+
+	*head = page;
+	*ntails = nr - i;
+}
+
+#define for_each_compound_head(__i, __list, __npages, __head, __ntails) \
+	for (__i = 0, \
+	     compound_next(__i, __npages, __list, &(__head), &(__ntails)); \
+	     __i < __npages; __i += __ntails, \
+	     compound_next(__i, __npages, __list, &(__head), &(__ntails)))
+
 /**
  * unpin_user_pages_dirty_lock() - release and optionally dirty gup-pinned pages
  * @pages:  array of pages to be maybe marked dirty, and definitely released.
@@ -268,20 +299,15 @@ void unpin_user_pages_dirty_lock(struct page **pages, unsigned long npages,
 				 bool make_dirty)
 {
 	unsigned long index;
-
-	/*
-	 * TODO: this can be optimized for huge pages: if a series of pages is
-	 * physically contiguous and part of the same compound page, then a
-	 * single operation to the head page should suffice.
-	 */
+	struct page *head;
+	unsigned int ntails;
 
 	if (!make_dirty) {
 		unpin_user_pages(pages, npages);
 		return;
 	}
 
-	for (index = 0; index < npages; index++) {
-		struct page *page = compound_head(pages[index]);
+	for_each_compound_head(index, pages, npages, head, ntails) {
 		/*
 		 * Checking PageDirty at this point may race with
 		 * clear_page_dirty_for_io(), but that's OK. Two key
@@ -302,9 +328,9 @@ void unpin_user_pages_dirty_lock(struct page **pages, unsigned long npages,
 		 * written back, so it gets written back again in the
 		 * next writeback cycle. This is harmless.
 		 */
-		if (!PageDirty(page))
-			set_page_dirty_lock(page);
-		unpin_user_page(page);
+		if (!PageDirty(head))
+			set_page_dirty_lock(head);
+		put_compound_head(head, ntails, FOLL_PIN);
 	}
 }
 EXPORT_SYMBOL(unpin_user_pages_dirty_lock);
@@ -321,6 +347,8 @@ EXPORT_SYMBOL(unpin_user_pages_dirty_lock);
 void unpin_user_pages(struct page **pages, unsigned long npages)
 {
 	unsigned long index;
+	struct page *head;
+	unsigned int ntails;
 
 	/*
 	 * If this WARN_ON() fires, then the system *might* be leaking pages (by
@@ -329,13 +357,9 @@ void unpin_user_pages(struct page **pages, unsigned long npages)
 	 */
 	if (WARN_ON(IS_ERR_VALUE(npages)))
 		return;
-	/*
-	 * TODO: this can be optimized for huge pages: if a series of pages is
-	 * physically contiguous and part of the same compound page, then a
-	 * single operation to the head page should suffice.
-	 */
-	for (index = 0; index < npages; index++)
-		unpin_user_page(pages[index]);
+
+	for_each_compound_head(index, pages, npages, head, ntails)
+		put_compound_head(head, ntails, FOLL_PIN);
 }
 EXPORT_SYMBOL(unpin_user_pages);
 
@@ -1436,6 +1460,67 @@ long populate_vma_page_range(struct vm_area_struct *vma,
 				NULL, NULL, locked);
 }
 
+/*
+ * faultin_vma_page_range() - populate (prefault) page tables inside the
+ *			      given VMA range readable/writable
+ *
+ * This is used by MADV_POPULATE_READ and MADV_POPULATE_WRITE, which may
+ * come from process_madvise() for another process.
+ *
+ * @vma: target vma
+ * @start: start address
+ * @end: end address
+ * @write: whether to prefault readable or writable
+ * @locked: whether the mmap_lock is still held
+ *
+ * Returns either number of processed pages in the vma, or a negative error
+ * code on error (see __get_user_pages()).
+ *
+ * vma->vm_mm->mmap_lock must be held. The range must be page-aligned and
+ * covered by the VMA.
+ *
+ * If @locked is NULL, it may be held for read or write and will be unperturbed.
+ *
+ * If @locked is non-NULL, it must held for read only and may be released.  If
+ * it's released, *@locked will be set to 0.
+ */
+long faultin_vma_page_range(struct vm_area_struct *vma, unsigned long start,
+			    unsigned long end, bool write, int *locked)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long nr_pages = (end - start) / PAGE_SIZE;
+	int gup_flags;
+
+	VM_BUG_ON(!PAGE_ALIGNED(start));
+	VM_BUG_ON(!PAGE_ALIGNED(end));
+	VM_BUG_ON_VMA(start < vma->vm_start, vma);
+	VM_BUG_ON_VMA(end > vma->vm_end, vma);
+	mmap_assert_locked(mm);
+
+	/*
+	 * FOLL_TOUCH: Mark page accessed and thereby young; will also mark
+	 *	       the page dirty with FOLL_WRITE -- which doesn't make a
+	 *	       difference with !FOLL_FORCE, because the page is writable
+	 *	       in the page table.
+	 * FOLL_HWPOISON: Return -EHWPOISON instead of -EFAULT when we hit
+	 *		  a poisoned page.
+	 * FOLL_POPULATE: Always populate memory with VM_LOCKONFAULT.
+	 * !FOLL_FORCE: Require proper access permissions.
+	 */
+	gup_flags = FOLL_TOUCH | FOLL_POPULATE | FOLL_MLOCK | FOLL_HWPOISON;
+	if (write)
+		gup_flags |= FOLL_WRITE;
+	if (mm != current->mm)
+		gup_flags |= FOLL_REMOTE;
+
+	/*
+	 * See check_vma_flags(): Will return -EFAULT on incompatible mappings
+	 * or with insufficient permissions.
+	 */
+	return __get_user_pages(mm, start, nr_pages, gup_flags,
+				NULL, NULL, locked);
+}
+
 /*
  * __mm_populate - populate and/or mlock pages within a range of address space.
  *
@@ -2141,6 +2226,69 @@ static void __maybe_unused undo_dev_pagemap(int *nr, int nr_start,
 }
 
 #ifdef CONFIG_ARCH_HAS_PTE_SPECIAL
+/*
+ * Does @pte still map @pfn the way gup_pte_range_compound() needs it to?
+ */
+static bool gup_pte_compound_match(pte_t pte, unsigned long pfn,
+				   unsigned int flags)
+{
+	return !pte_protnone(pte) &&
+		pte_access_permitted(pte, flags & FOLL_WRITE) &&
+		!pte_devmap(pte) && !pte_special(pte) && pte_pfn(pte) == pfn;
+}
+
+/*
+ * A pte-mapped THP is usually mapped by consecutive ptes.  Once the head
+ * page has been grabbed for @page, collect the following subpages that
+ * the next ptes map, up to @end, and grab them with a single
+ * try_grab_compound_head() on @head.  The ptes are read again after the
+ * grab, like gup_pte_range() does, and the subpages whose pte changed in
+ * the meantime are released again.  Returns the number of subpages added
+ * to @pages, @nr is advanced accordingly.
+ */
+static int gup_pte_range_compound(pte_t *ptep, unsigned long addr,
+				  unsigned long end, unsigned int flags,
+				  struct page *head, struct page *page,
+				  struct page **pages, int *nr)
+{
+	unsigned long pfn = page_to_pfn(page);
+	unsigned long left = compound_nr(head) - (page - head) - 1;
+	int refs = 0, i;
+
+	while (refs < left && addr + (refs + 1) * PAGE_SIZE != end) {
+		pte_t pte = gup_get_pte(ptep + refs + 1);
+
+		if (!gup_pte_compound_match(pte, pfn + refs + 1, flags))
+			break;
+
+		page = pte_page(pte);
+		if ((flags & FOLL_PIN) && arch_make_page_accessible(page))
+			break;
+
+		pages[*nr + refs] = page;
+		refs++;
+	}
+
+	if (!refs)
+		return 0;
+
+	if (!try_grab_compound_head(head, refs, flags))
+		return 0;
+
+	for (i = 0; i < refs; i++) {
+		pte_t pte = gup_get_pte(ptep + i + 1);
+
+		if (!gup_pte_compound_match(pte, pfn + i + 1, flags)) {
+			put_compound_head(head, refs - i, flags);
+			refs = i;
+			break;
+		}
+	}
+
+	*nr += refs;
+	return refs;
+}
+
 static int gup_pte_range(pmd_t pmd, unsigned long addr, unsigned long end,
 			 unsigned int flags, struct page **pages, int *nr)
 {
@@ -2206,6 +2354,13 @@ static int gup_pte_range(pmd_t pmd, unsigned long addr, unsigned long end,
 		pages[*nr] = page;
 		(*nr)++;
 
+		if (PageCompound(head) && !pte_devmap(pte)) {
+			int refs = gup_pte_range_compound(ptep, addr, end, flags,
+							  head, page, pages, nr);
+
+			ptep += refs;
+			addr += refs * PAGE_SIZE;
+		}
 	} while (ptep++, addr += PAGE_SIZE, addr != end);
 
 	ret = 1;
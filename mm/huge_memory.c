@@ -33,6 +33,8 @@
 #include <linux/oom.h>
 #include <linux/numa.h>
 #include <linux/page_owner.h>
+#include <linux/pgalloc_tag.h>
+#include <linux/page_prezero.h>
 
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
@@ -566,9 +568,21 @@ unsigned long thp_get_unmapped_area(struct file *filp, unsigned long addr,
 {
 	unsigned long ret;
 	loff_t off = (loff_t)pgoff << PAGE_SHIFT;
+	struct inode *inode = filp->f_mapping->host;
 
-	if (!IS_DAX(filp->f_mapping->host) || !IS_ENABLED(CONFIG_FS_DAX_PMD))
+	/*
+	 * DAX maps the file with PMDs directly.  Regular page cache files can
+	 * only get PMD mappings once khugepaged has collapsed the read-only
+	 * text, which requires the virtual address and file offset to agree
+	 * modulo HPAGE_PMD_SIZE, so align those from the start.
+	 */
+	if (IS_DAX(inode)) {
+		if (!IS_ENABLED(CONFIG_FS_DAX_PMD))
+			goto out;
+	} else if (!IS_ENABLED(CONFIG_READ_ONLY_THP_FOR_FS) ||
+		   !S_ISREG(inode->i_mode)) {
 		goto out;
+	}
 
 	ret = __thp_get_unmapped_area(filp, addr, len, off, flags, PMD_SIZE);
 	if (ret)
@@ -579,7 +593,7 @@ out:
 EXPORT_SYMBOL_GPL(thp_get_unmapped_area);
 
 static vm_fault_t __do_huge_pmd_anonymous_page(struct vm_fault *vmf,
-			struct page *page, gfp_t gfp)
+			struct page *page, gfp_t gfp, bool zeroed)
 {
 	struct vm_area_struct *vma = vmf->vma;
 	pgtable_t pgtable;
@@ -602,7 +616,8 @@ static vm_fault_t __do_huge_pmd_anonymous_page(struct vm_fault *vmf,
 		goto release;
 	}
 
-	clear_huge_page(page, vmf->address, HPAGE_PMD_NR);
+	if (!zeroed)
+		clear_huge_page(page, vmf->address, HPAGE_PMD_NR);
 	/*
 	 * The memory barrier inside __SetPageUptodate makes sure that
 	 * clear_huge_page writes become visible before the set_pmd_at()
@@ -714,6 +729,7 @@ vm_fault_t do_huge_pmd_anonymous_page(struct vm_fault *vmf)
 	gfp_t gfp;
 	struct page *page;
 	unsigned long haddr = vmf->address & HPAGE_PMD_MASK;
+	bool zeroed;
 
 	if (!transhuge_vma_suitable(vma, haddr))
 		return VM_FAULT_FALLBACK;
@@ -760,13 +776,16 @@ vm_fault_t do_huge_pmd_anonymous_page(struct vm_fault *vmf)
 		return ret;
 	}
 	gfp = alloc_hugepage_direct_gfpmask(vma);
-	page = alloc_hugepage_vma(gfp, vma, haddr, HPAGE_PMD_ORDER);
+	page = prezero_alloc_vma(gfp, vma, HPAGE_PMD_ORDER);
+	zeroed = page != NULL;
+	if (!page)
+		page = alloc_hugepage_vma(gfp, vma, haddr, HPAGE_PMD_ORDER);
 	if (unlikely(!page)) {
 		count_vm_event(THP_FAULT_FALLBACK);
 		return VM_FAULT_FALLBACK;
 	}
 	prep_transhuge_page(page);
-	return __do_huge_pmd_anonymous_page(vmf, page, gfp);
+	return __do_huge_pmd_anonymous_page(vmf, page, gfp, zeroed);
 }
 
 static void insert_pfn_pmd(struct vm_area_struct *vma, unsigned long addr,
@@ -2485,6 +2504,7 @@ static void __split_huge_page(struct page *page, struct list_head *list,
 	ClearPageCompound(head);
 
 	split_page_owner(head, nr);
+	pgalloc_tag_split(head, nr);
 
 	/* See comment in __split_huge_page_tail() */
 	if (PageAnon(head)) {
@@ -2625,6 +2645,19 @@ bool can_split_huge_page(struct page *page, int *pextra_pins)
 	return total_mapcount(page) == page_count(page) - extra_pins - 1;
 }
 
+/* memory_failure() marks the poisoned subpage before splitting the THP */
+static bool thp_has_hwpoison(struct page *head)
+{
+	int i;
+
+	if (!IS_ENABLED(CONFIG_MEMORY_FAILURE))
+		return false;
+	for (i = 0; i < thp_nr_pages(head); i++)
+		if (PageHWPoison(head + i))
+			return true;
+	return false;
+}
+
 /*
  * This function splits huge page into normal pages. @page can point to any
  * subpage of huge page to split. Split doesn't change the position of @page.
@@ -2688,6 +2721,15 @@ int split_huge_page_to_list(struct page *page, struct list_head *list)
 			goto out;
 		}
 
+		/*
+		 * Sealed against it: see memfd_create(MFD_HUGEPAGE).  But
+		 * memory failure handling must still isolate a poisoned page.
+		 */
+		if (shmem_mapping_nosplit(mapping) && !thp_has_hwpoison(head)) {
+			ret = -EBUSY;
+			goto out;
+		}
+
 		anon_vma = NULL;
 		i_mmap_lock_read(mapping);
 
@@ -30,6 +30,7 @@
 #include <linux/numa.h>
 #include <linux/llist.h>
 #include <linux/cma.h>
+#include <linux/padata.h>
 
 #include <asm/page.h>
 #include <asm/pgalloc.h>
@@ -42,6 +43,7 @@
 #include <linux/userfaultfd_k.h>
 #include <linux/page_owner.h>
 #include "internal.h"
+#include "hugetlb_vmemmap.h"
 
 int hugetlb_max_hstate __read_mostly;
 unsigned int default_hstate_idx;
@@ -1200,19 +1202,24 @@ static int get_valid_node_allowed(int nid, nodemask_t *nodes_allowed)
  * next node from which to allocate, handling wrap at end of node
  * mask.
  */
-static int hstate_next_node_to_alloc(struct hstate *h,
-					nodemask_t *nodes_allowed)
+static int next_node_to_alloc(int *next_nid, nodemask_t *nodes_allowed)
 {
 	int nid;
 
 	VM_BUG_ON(!nodes_allowed);
 
-	nid = get_valid_node_allowed(h->next_nid_to_alloc, nodes_allowed);
-	h->next_nid_to_alloc = next_node_allowed(nid, nodes_allowed);
+	nid = get_valid_node_allowed(*next_nid, nodes_allowed);
+	*next_nid = next_node_allowed(nid, nodes_allowed);
 
 	return nid;
 }
 
+static int hstate_next_node_to_alloc(struct hstate *h,
+					nodemask_t *nodes_allowed)
+{
+	return next_node_to_alloc(&h->next_nid_to_alloc, nodes_allowed);
+}
+
 /*
  * helper for free_pool_huge_page() - return the previously saved
  * node ["this node"] from which to free a huge page.  Advance the
@@ -1334,16 +1341,36 @@ static inline void destroy_compound_gigantic_page(struct page *page,
 						unsigned int order) { }
 #endif
 
-static void update_and_free_page(struct hstate *h, struct page *page)
+/*
+ * Give a HugeTLB page that is leaving the pool its full vmemmap back, so its
+ * tail struct pages become writable again.  Called with hugetlb_lock held and
+ * the page already taken off the free or active lists; the lock is dropped
+ * while the vmemmap pages are allocated.
+ */
+static int restore_huge_page_vmemmap(struct hstate *h, struct page *head)
+{
+	int ret;
+
+	if (!PageHugeVmemmapOptimized(head))
+		return 0;
+
+	spin_unlock(&hugetlb_lock);
+	ret = alloc_huge_page_vmemmap(h, head);
+	spin_lock(&hugetlb_lock);
+
+	return ret;
+}
+
+/*
+ * Hand a HugeTLB page, already accounted out of the pool and with its full
+ * vmemmap, back to the buddy or contiguous allocator.  May block for a
+ * gigantic page, so called without hugetlb_lock held for those.
+ */
+static void __update_and_free_page(struct hstate *h, struct page *page)
 {
 	int i;
 	struct page *subpage = page;
 
-	if (hstate_is_gigantic(h) && !gigantic_page_runtime_supported())
-		return;
-
-	h->nr_huge_pages--;
-	h->nr_huge_pages_node[page_to_nid(page)]--;
 	for (i = 0; i < pages_per_huge_page(h);
 	     i++, subpage = mem_map_next(subpage, page, i)) {
 		subpage->flags &= ~(1 << PG_locked | 1 << PG_error |
@@ -1355,17 +1382,91 @@ static void update_and_free_page(struct hstate *h, struct page *page)
 	VM_BUG_ON_PAGE(hugetlb_cgroup_from_page_rsvd(page), page);
 	set_compound_page_dtor(page, NULL_COMPOUND_DTOR);
 	set_page_refcounted(page);
+	if (hstate_is_gigantic(h)) {
+		destroy_compound_gigantic_page(page, huge_page_order(h));
+		free_gigantic_page(page, huge_page_order(h));
+	} else {
+		__free_pages(page, huge_page_order(h));
+	}
+}
+
+/*
+ * Pages whose vmemmap has to be allocated again before they can be freed
+ * are handed to free_hpage_vmemmap_workfn(): the allocation may sleep, and
+ * update_and_free_page() is called with hugetlb_lock held, from
+ * free_huge_page() in atomic context too.  Like hpage_freelist below, the
+ * list is linked through page->mapping.
+ */
+static LLIST_HEAD(hpage_vmemmap_freelist);
+
+static void free_hpage_vmemmap_workfn(struct work_struct *work)
+{
+	struct llist_node *node;
+	struct page *page;
+	struct hstate *h;
+	int nid;
+
+	node = llist_del_all(&hpage_vmemmap_freelist);
+
+	while (node) {
+		page = container_of((struct address_space **)node,
+				     struct page, mapping);
+		node = node->next;
+		page->mapping = NULL;
+		h = page_hstate(page);
+		nid = page_to_nid(page);
+
+		if (alloc_huge_page_vmemmap(h, page)) {
+			/*
+			 * The page cannot go back to the buddy allocator
+			 * without its vmemmap: keep it in the pool as a free
+			 * surplus page, to be freed again when the pool
+			 * shrinks.
+			 */
+			spin_lock(&hugetlb_lock);
+			h->nr_huge_pages++;
+			h->nr_huge_pages_node[nid]++;
+			h->surplus_huge_pages++;
+			h->surplus_huge_pages_node[nid]++;
+			INIT_LIST_HEAD(&page->lru);
+			arch_clear_hugepage_flags(page);
+			enqueue_huge_page(h, page);
+			spin_unlock(&hugetlb_lock);
+			continue;
+		}
+
+		__update_and_free_page(h, page);
+		cond_resched();
+	}
+}
+static DECLARE_WORK(free_hpage_vmemmap_work, free_hpage_vmemmap_workfn);
+
+/* Called with hugetlb_lock held, the page off the free and active lists */
+static void update_and_free_page(struct hstate *h, struct page *page)
+{
+	if (hstate_is_gigantic(h) && !gigantic_page_runtime_supported())
+		return;
+
+	h->nr_huge_pages--;
+	h->nr_huge_pages_node[page_to_nid(page)]--;
+
+	if (PageHugeVmemmapOptimized(page)) {
+		if (llist_add((struct llist_node *)&page->mapping,
+			      &hpage_vmemmap_freelist))
+			schedule_work(&free_hpage_vmemmap_work);
+		return;
+	}
+
 	if (hstate_is_gigantic(h)) {
 		/*
 		 * Temporarily drop the hugetlb_lock, because
 		 * we might block in free_gigantic_page().
 		 */
 		spin_unlock(&hugetlb_lock);
-		destroy_compound_gigantic_page(page, huge_page_order(h));
-		free_gigantic_page(page, huge_page_order(h));
+		__update_and_free_page(h, page);
 		spin_lock(&hugetlb_lock);
 	} else {
-		__free_pages(page, huge_page_order(h));
+		__update_and_free_page(h, page);
 	}
 }
 
@@ -1541,6 +1642,7 @@ void free_huge_page(struct page *page)
 
 static void prep_new_huge_page(struct hstate *h, struct page *page, int nid)
 {
+	free_huge_page_vmemmap(h, page);
 	INIT_LIST_HEAD(&page->lru);
 	set_compound_page_dtor(page, HUGETLB_PAGE_DTOR);
 	set_hugetlb_cgroup(page, NULL);
@@ -1718,16 +1820,17 @@ static struct page *alloc_fresh_huge_page(struct hstate *h,
 
 /*
  * Allocates a fresh page to the hugetlb allocator pool in the node interleaved
- * manner.
+ * manner, @next_nid being the caller's cursor into @nodes_allowed.
  */
 static int alloc_pool_huge_page(struct hstate *h, nodemask_t *nodes_allowed,
-				nodemask_t *node_alloc_noretry)
+				nodemask_t *node_alloc_noretry, int *next_nid)
 {
-	struct page *page;
+	struct page *page = NULL;
 	int nr_nodes, node;
 	gfp_t gfp_mask = htlb_alloc_mask(h) | __GFP_THISNODE;
 
-	for_each_node_mask_to_alloc(h, nr_nodes, node, nodes_allowed) {
+	for (nr_nodes = nodes_weight(*nodes_allowed); nr_nodes > 0; nr_nodes--) {
+		node = next_node_to_alloc(next_nid, nodes_allowed);
 		page = alloc_fresh_huge_page(h, gfp_mask, node, nodes_allowed,
 						node_alloc_noretry);
 		if (page)
@@ -1742,6 +1845,74 @@ static int alloc_pool_huge_page(struct hstate *h, nodemask_t *nodes_allowed,
 	return 1;
 }
 
+/* Pages per helper thread between signal checks when growing the pool */
+#define HUGETLB_ALLOC_BATCH	64UL
+
+struct hugetlb_pool_alloc {
+	struct hstate *h;
+	nodemask_t *nodes_allowed;
+	nodemask_t *node_alloc_noretry;
+	atomic_long_t nr_allocated;
+};
+
+static void alloc_pool_huge_pages_fn(unsigned long start, unsigned long end,
+				     void *arg)
+{
+	struct hugetlb_pool_alloc *pa = arg;
+	int nr_nodes = nodes_weight(*pa->nodes_allowed);
+	int next_nid = first_node(*pa->nodes_allowed);
+	unsigned long i;
+
+	/*
+	 * Each chunk keeps its own node cursor, starting on a different node
+	 * so that concurrent chunks do not all hammer the same one, instead
+	 * of racing on h->next_nid_to_alloc.
+	 */
+	for (i = nr_nodes ? start % nr_nodes : 0; i; i--)
+		next_nid = next_node_allowed(next_nid, pa->nodes_allowed);
+
+	for (i = start; i < end; i++) {
+		if (!alloc_pool_huge_page(pa->h, pa->nodes_allowed,
+					  pa->node_alloc_noretry, &next_nid))
+			break;
+		atomic_long_inc(&pa->nr_allocated);
+		cond_resched();
+	}
+}
+
+/*
+ * Allocate up to @nr_pages fresh huge pages into the pool.  The work is
+ * spread over several helper threads, two per allowed node, which pays off
+ * when the pool grows by hundreds of pages or by gigantic pages.  Returns
+ * the number of pages actually added.
+ */
+static unsigned long alloc_pool_huge_pages(struct hstate *h,
+					   unsigned long nr_pages,
+					   nodemask_t *nodes_allowed,
+					   nodemask_t *node_alloc_noretry)
+{
+	struct hugetlb_pool_alloc pa = {
+		.h			= h,
+		.nodes_allowed		= nodes_allowed,
+		.node_alloc_noretry	= node_alloc_noretry,
+		.nr_allocated		= ATOMIC_LONG_INIT(0),
+	};
+	int nr_nodes = max(nodes_weight(*nodes_allowed), 1);
+	struct padata_mt_job job = {
+		.thread_fn	= alloc_pool_huge_pages_fn,
+		.fn_arg		= &pa,
+		.start		= 0,
+		.size		= nr_pages,
+		.align		= 1,
+		.min_chunk	= max(nr_pages / nr_nodes / 2, 1UL),
+		.max_threads	= nr_nodes * 2,
+	};
+
+	padata_do_multithreaded(&job);
+
+	return atomic_long_read(&pa.nr_allocated);
+}
+
 /*
  * Free huge page from pool from next node to free.
  * Attempt to keep persistent huge pages more or less
@@ -1787,6 +1958,8 @@ static int free_pool_huge_page(struct hstate *h, nodemask_t *nodes_allowed,
  *
  *  -EBUSY: failed to dissolved free hugepages or the hugepage is in-use
  *          (allocated or reserved.)
+ * -ENOMEM: failed to allocate the vmemmap of a free hugepage whose vmemmap
+ *          pages had been freed (see hugetlb_vmemmap.c)
  *       0: successfully dissolved free hugepages or the page is not a
  *          hugepage (considered as already dissolved)
  */
@@ -1831,6 +2004,22 @@ retry:
 			goto retry;
 		}
 
+		list_del(&head->lru);
+		ClearPageHugeFreed(head);
+		h->free_huge_pages--;
+		h->free_huge_pages_node[nid]--;
+
+		/*
+		 * The tail struct pages have to be writable before the
+		 * PageHWPoison flag can be moved onto one of them.
+		 */
+		if (restore_huge_page_vmemmap(h, head)) {
+			INIT_LIST_HEAD(&head->lru);
+			enqueue_huge_page(h, head);
+			rc = -ENOMEM;
+			goto out;
+		}
+
 		/*
 		 * Move PageHWPoison flag from head page to the raw error page,
 		 * which makes any subpages rather than the error page reusable.
@@ -1839,9 +2028,6 @@ retry:
 			SetPageHWPoison(page);
 			ClearPageHWPoison(head);
 		}
-		list_del(&head->lru);
-		h->free_huge_pages--;
-		h->free_huge_pages_node[nid]--;
 		h->max_huge_pages--;
 		update_and_free_page(h, head);
 		rc = 0;
@@ -2528,19 +2714,20 @@ static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 	if (node_alloc_noretry)
 		nodes_clear(*node_alloc_noretry);
 
-	for (i = 0; i < h->max_huge_pages; ++i) {
-		if (hstate_is_gigantic(h)) {
+	if (hstate_is_gigantic(h)) {
+		for (i = 0; i < h->max_huge_pages; ++i) {
 			if (hugetlb_cma_size) {
 				pr_warn_once("HugeTLB: hugetlb_cma is enabled, skip boot time allocation\n");
 				goto free;
 			}
 			if (!alloc_bootmem_huge_page(h))
 				break;
-		} else if (!alloc_pool_huge_page(h,
-					 &node_states[N_MEMORY],
-					 node_alloc_noretry))
-			break;
-		cond_resched();
+			cond_resched();
+		}
+	} else {
+		i = alloc_pool_huge_pages(h, h->max_huge_pages,
+					  &node_states[N_MEMORY],
+					  node_alloc_noretry);
 	}
 	if (i < h->max_huge_pages) {
 		char buf[32];
@@ -2717,6 +2904,16 @@ static int set_max_huge_pages(struct hstate *h, unsigned long count, int nid,
 	}
 
 	while (count > persistent_huge_pages(h)) {
+		/*
+		 * Allocate in batches so that signals are still noticed when
+		 * growing the pool by a lot.  Gigantic pages are slow enough
+		 * to allocate that each thread only gets one per batch.
+		 */
+		unsigned long nr_pages = count - persistent_huge_pages(h);
+		unsigned long batch = nodes_weight(*nodes_allowed) * 2 *
+				(hstate_is_gigantic(h) ? 1 : HUGETLB_ALLOC_BATCH);
+
+		nr_pages = min(nr_pages, batch);
 		/*
 		 * If this allocation races such that we no longer need the
 		 * page, free_huge_page will handle it by freeing the page
@@ -2727,10 +2924,10 @@ static int set_max_huge_pages(struct hstate *h, unsigned long count, int nid,
 		/* yield cpu to avoid soft lockup */
 		cond_resched();
 
-		ret = alloc_pool_huge_page(h, nodes_allowed,
-						node_alloc_noretry);
+		ret = alloc_pool_huge_pages(h, nr_pages, nodes_allowed,
+					    node_alloc_noretry);
 		spin_lock(&hugetlb_lock);
-		if (!ret)
+		if (ret < nr_pages)
 			goto out;
 
 		/* Bail for signals. Probably ctrl-c from user */
@@ -3262,6 +3459,7 @@ void __init hugetlb_add_hstate(unsigned int order)
 	h->next_nid_to_free = first_memory_node;
 	snprintf(h->name, HSTATE_NAME_LEN, "hugepages-%lukB",
 					huge_page_size(h)/1024);
+	hugetlb_vmemmap_init(h);
 
 	parsed_hstate = h;
 }
@@ -4323,6 +4521,43 @@ int huge_add_to_page_cache(struct page *page, struct address_space *mapping,
 	return 0;
 }
 
+static inline vm_fault_t hugetlb_handle_userfault(struct vm_area_struct *vma,
+						  struct address_space *mapping,
+						  pgoff_t idx,
+						  unsigned int flags,
+						  unsigned long haddr,
+						  unsigned long reason)
+{
+	vm_fault_t ret;
+	u32 hash;
+	struct vm_fault vmf = {
+		.vma = vma,
+		.address = haddr,
+		.flags = flags,
+		/*
+		 * Hard to debug if it ends up being
+		 * used by a callee that assumes
+		 * something about the other
+		 * uninitialized fields... same as in
+		 * memory.c
+		 */
+	};
+
+	/*
+	 * hugetlb_fault_mutex and i_mmap_rwsem must be
+	 * dropped before handling userfault.  Reacquire
+	 * after handling fault to make calling code simpler.
+	 */
+	hash = hugetlb_fault_mutex_hash(mapping, idx);
+	mutex_unlock(&hugetlb_fault_mutex_table[hash]);
+	i_mmap_unlock_read(mapping);
+	ret = handle_userfault(&vmf, reason);
+	i_mmap_lock_read(mapping);
+	mutex_lock(&hugetlb_fault_mutex_table[hash]);
+
+	return ret;
+}
+
 static vm_fault_t hugetlb_no_page(struct mm_struct *mm,
 			struct vm_area_struct *vma,
 			struct address_space *mapping, pgoff_t idx,
@@ -4365,31 +4600,9 @@ retry:
 		 * Check for page in userfault range
 		 */
 		if (userfaultfd_missing(vma)) {
-			u32 hash;
-			struct vm_fault vmf = {
-				.vma = vma,
-				.address = haddr,
-				.flags = flags,
-				/*
-				 * Hard to debug if it ends up being
-				 * used by a callee that assumes
-				 * something about the other
-				 * uninitialized fields... same as in
-				 * memory.c
-				 */
-			};
-
-			/*
-			 * hugetlb_fault_mutex and i_mmap_rwsem must be
-			 * dropped before handling userfault.  Reacquire
-			 * after handling fault to make calling code simpler.
-			 */
-			hash = hugetlb_fault_mutex_hash(mapping, idx);
-			mutex_unlock(&hugetlb_fault_mutex_table[hash]);
-			i_mmap_unlock_read(mapping);
-			ret = handle_userfault(&vmf, VM_UFFD_MISSING);
-			i_mmap_lock_read(mapping);
-			mutex_lock(&hugetlb_fault_mutex_table[hash]);
+			ret = hugetlb_handle_userfault(vma, mapping, idx,
+						       flags, haddr,
+						       VM_UFFD_MISSING);
 			goto out;
 		}
 
@@ -4448,6 +4661,16 @@ retry:
 				VM_FAULT_SET_HINDEX(hstate_index(h));
 			goto backout_unlocked;
 		}
+
+		/* Check for page in userfault range. */
+		if (userfaultfd_minor(vma)) {
+			unlock_page(page);
+			put_page(page);
+			ret = hugetlb_handle_userfault(vma, mapping, idx,
+						       flags, haddr,
+						       VM_UFFD_MINOR);
+			goto out;
+		}
 	}
 
 	/*
@@ -4688,17 +4911,20 @@ out_mutex:
 	return ret;
 }
 
+#ifdef CONFIG_USERFAULTFD
 /*
- * Used by userfaultfd UFFDIO_COPY.  Based on mcopy_atomic_pte with
- * modifications for huge pages.
+ * Used by userfaultfd UFFDIO_COPY and UFFDIO_CONTINUE.  Based on
+ * mcopy_atomic_pte with modifications for huge pages.
  */
 int hugetlb_mcopy_atomic_pte(struct mm_struct *dst_mm,
 			    pte_t *dst_pte,
 			    struct vm_area_struct *dst_vma,
 			    unsigned long dst_addr,
 			    unsigned long src_addr,
+			    enum mcopy_atomic_mode mode,
 			    struct page **pagep)
 {
+	bool is_continue = (mode == MCOPY_ATOMIC_CONTINUE);
 	struct address_space *mapping;
 	pgoff_t idx;
 	unsigned long size;
@@ -4707,9 +4933,19 @@ int hugetlb_mcopy_atomic_pte(struct mm_struct *dst_mm,
 	pte_t _dst_pte;
 	spinlock_t *ptl;
 	int ret;
+	int writable;
 	struct page *page;
 
-	if (!*pagep) {
+	mapping = dst_vma->vm_file->f_mapping;
+	idx = vma_hugecache_offset(h, dst_vma, dst_addr);
+
+	if (is_continue) {
+		/* Map the page that is already in the page cache. */
+		ret = -EFAULT;
+		page = find_lock_page(mapping, idx);
+		if (!page)
+			goto out;
+	} else if (!*pagep) {
 		/* If a page already exists, then it's UFFDIO_COPY for
 		 * a non-missing case. Return -EEXIST.
 		 */
@@ -4746,15 +4982,13 @@ int hugetlb_mcopy_atomic_pte(struct mm_struct *dst_mm,
 	 * preceding stores to the page contents become visible before
 	 * the set_pte_at() write.
 	 */
-	__SetPageUptodate(page);
-
-	mapping = dst_vma->vm_file->f_mapping;
-	idx = vma_hugecache_offset(h, dst_vma, dst_addr);
+	if (!is_continue)
+		__SetPageUptodate(page);
 
 	/*
-	 * If shared, add to page cache
+	 * If shared, add newly allocated pages to the page cache
 	 */
-	if (vm_shared) {
+	if (vm_shared && !is_continue) {
 		size = i_size_read(mapping->host) >> huge_page_shift(h);
 		ret = -EFAULT;
 		if (idx >= size)
@@ -4792,42 +5026,50 @@ int hugetlb_mcopy_atomic_pte(struct mm_struct *dst_mm,
 	if (!huge_pte_none(huge_ptep_get(dst_pte)))
 		goto out_release_unlock;
 
-	if (vm_shared) {
+	if (vm_shared || is_continue) {
 		page_dup_rmap(page, true);
 	} else {
 		ClearPagePrivate(page);
 		hugepage_add_new_anon_rmap(page, dst_vma, dst_addr);
 	}
 
-	_dst_pte = make_huge_pte(dst_vma, page, dst_vma->vm_flags & VM_WRITE);
-	if (dst_vma->vm_flags & VM_WRITE)
+	/* For CONTINUE on a private mapping, leave it read-only for COW. */
+	if (is_continue && !vm_shared)
+		writable = 0;
+	else
+		writable = dst_vma->vm_flags & VM_WRITE;
+
+	_dst_pte = make_huge_pte(dst_vma, page, writable);
+	if (writable)
 		_dst_pte = huge_pte_mkdirty(_dst_pte);
 	_dst_pte = pte_mkyoung(_dst_pte);
 
 	set_huge_pte_at(dst_mm, dst_addr, dst_pte, _dst_pte);
 
 	(void)huge_ptep_set_access_flags(dst_vma, dst_addr, dst_pte, _dst_pte,
-					dst_vma->vm_flags & VM_WRITE);
+					writable);
 	hugetlb_count_add(pages_per_huge_page(h), dst_mm);
 
 	/* No need to invalidate - it was non-present before */
 	update_mmu_cache(dst_vma, dst_addr, dst_pte);
 
 	spin_unlock(ptl);
-	set_page_huge_active(page);
-	if (vm_shared)
+	if (!is_continue)
+		set_page_huge_active(page);
+	if (vm_shared || is_continue)
 		unlock_page(page);
 	ret = 0;
 out:
 	return ret;
 out_release_unlock:
 	spin_unlock(ptl);
-	if (vm_shared)
+	if (vm_shared || is_continue)
 		unlock_page(page);
 out_release_nounlock:
 	put_page(page);
 	goto out;
 }
+#endif /* CONFIG_USERFAULTFD */
 
 long follow_hugetlb_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			 struct page **pages, struct vm_area_struct **vmas,
@@ -19,6 +19,7 @@
 #include <linux/sched.h>
 #include <linux/sched/mm.h>
 #include <linux/uio.h>
+#include <linux/compat.h>
 #include <linux/ksm.h>
 #include <linux/fs.h>
 #include <linux/file.h>
@@ -53,6 +54,8 @@ static int madvise_need_mmap_write(int behavior)
 	case MADV_COLD:
 	case MADV_PAGEOUT:
 	case MADV_FREE:
+	case MADV_POPULATE_READ:
+	case MADV_POPULATE_WRITE:
 		return 0;
 	default:
 		/* be safe, default to 1. list exceptions explicitly */
@@ -870,6 +873,61 @@ static long madvise_remove(struct vm_area_struct *vma,
 	return error;
 }
 
+static long madvise_populate(struct vm_area_struct *vma,
+			     struct vm_area_struct **prev,
+			     unsigned long start, unsigned long end,
+			     int behavior)
+{
+	const bool write = behavior == MADV_POPULATE_WRITE;
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long tmp_end;
+	int locked = 1;
+	long pages;
+
+	*prev = vma;
+
+	while (start < end) {
+		/*
+		 * We might have temporarily dropped the lock. For example,
+		 * our VMA might have been split.
+		 */
+		if (!vma || start >= vma->vm_end) {
+			vma = find_vma(mm, start);
+			if (!vma || start < vma->vm_start)
+				return -ENOMEM;
+		}
+
+		tmp_end = min_t(unsigned long, end, vma->vm_end);
+		/* Populate (prefault) page tables readable/writable. */
+		pages = faultin_vma_page_range(vma, start, tmp_end, write,
+					       &locked);
+		if (!locked) {
+			mmap_read_lock(mm);
+			locked = 1;
+			*prev = NULL;
+			vma = NULL;
+		}
+		if (pages < 0) {
+			switch (pages) {
+			case -EINTR:
+				return -EINTR;
+			case -EFAULT: /* Incompatible mappings / permissions. */
+				return -EINVAL;
+			case -EHWPOISON:
+				return -EHWPOISON;
+			default:
+				pr_warn_once("%s: unhandled return value: %ld\n",
+					     __func__, pages);
+				fallthrough;
+			case -ENOMEM:
+				return -ENOMEM;
+			}
+		}
+		start += pages * PAGE_SIZE;
+	}
+	return 0;
+}
+
 #ifdef CONFIG_MEMORY_FAILURE
 /*
  * Error injection support for memory error handling.
@@ -939,6 +997,9 @@ madvise_vma(struct vm_area_struct *vma, struct vm_area_struct **prev,
 	case MADV_FREE:
 	case MADV_DONTNEED:
 		return madvise_dontneed_free(vma, prev, start, end, behavior);
+	case MADV_POPULATE_READ:
+	case MADV_POPULATE_WRITE:
+		return madvise_populate(vma, prev, start, end, behavior);
 	default:
 		return madvise_behavior(vma, prev, start, end, behavior);
 	}
@@ -959,6 +1020,8 @@ madvise_behavior_valid(int behavior)
 	case MADV_FREE:
 	case MADV_COLD:
 	case MADV_PAGEOUT:
+	case MADV_POPULATE_READ:
+	case MADV_POPULATE_WRITE:
 #ifdef CONFIG_KSM
 	case MADV_MERGEABLE:
 	case MADV_UNMERGEABLE:
@@ -982,18 +1045,140 @@ madvise_behavior_valid(int behavior)
 	}
 }
 
+/*
+ * process_madvise() only accepts hints that cannot lose data of the target
+ * and that do not need the target's own context (madvise_remove() and
+ * madvise_dontneed_free() may drop the mmap_lock to talk to userfaultfd).
+ * MADV_POPULATE_WRITE is not one of them: it breaks COW and dirties shared
+ * file pages of the target.
+ */
 static bool
 process_madvise_behavior_valid(int behavior)
 {
 	switch (behavior) {
+	case MADV_WILLNEED:
 	case MADV_COLD:
 	case MADV_PAGEOUT:
+	case MADV_POPULATE_READ:
+#ifdef CONFIG_KSM
+	case MADV_MERGEABLE:
+	case MADV_UNMERGEABLE:
+#endif
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	case MADV_HUGEPAGE:
+	case MADV_NOHUGEPAGE:
+#endif
 		return true;
 	default:
 		return false;
 	}
 }
 
+/*
+ * Check that [@start, @start + @len_in) is a valid madvise range and set
+ * *@end to its page aligned end, which equals @start for an empty range.
+ */
+static int madvise_range(unsigned long start, size_t len_in,
+			 unsigned long *end)
+{
+	size_t len;
+
+	if (!PAGE_ALIGNED(start))
+		return -EINVAL;
+	len = PAGE_ALIGN(len_in);
+
+	/* Check to see whether len was rounded up from small -ve to zero */
+	if (len_in && !len)
+		return -EINVAL;
+
+	*end = start + len;
+	if (*end < start)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Take the mmap_lock of @mm the way madvise_need_mmap_write() asks for */
+static int madvise_lock(struct mm_struct *mm, int write)
+{
+	if (write)
+		return mmap_write_lock_killable(mm);
+	mmap_read_lock(mm);
+	return 0;
+}
+
+static void madvise_unlock(struct mm_struct *mm, int write)
+{
+	if (write)
+		mmap_write_unlock(mm);
+	else
+		mmap_read_unlock(mm);
+}
+
+/*
+ * Apply @behavior to the vmas of [@start, @end).  The caller holds the
+ * mmap_lock of @mm the way madvise_need_mmap_write() asks for.  *@advised
+ * is set to the number of bytes from @start that were advised before the
+ * first error, that is the whole range on success.
+ */
+static int madvise_walk_vmas(struct mm_struct *mm, unsigned long start,
+			     unsigned long end, int behavior, size_t *advised)
+{
+	unsigned long tmp, orig_start = start, failed = end;
+	struct vm_area_struct *vma, *prev;
+	int unmapped_error = 0;
+	int error;
+
+	/*
+	 * If the interval [start,end) covers some unmapped address
+	 * ranges, just ignore them, but return -ENOMEM at the end.
+	 * - different from the way of handling in mlock etc.
+	 */
+	vma = find_vma_prev(mm, start, &prev);
+	if (vma && start > vma->vm_start)
+		prev = vma;
+
+	for (;;) {
+		/* Still start < end. */
+		error = -ENOMEM;
+		if (!vma)
+			goto out;
+
+		/* Here start < (end|vma->vm_end). */
+		if (start < vma->vm_start) {
+			if (!unmapped_error)
+				failed = start;
+			unmapped_error = -ENOMEM;
+			start = vma->vm_start;
+			if (start >= end)
+				goto out;
+		}
+
+		/* Here vma->vm_start <= start < (end|vma->vm_end) */
+		tmp = vma->vm_end;
+		if (end < tmp)
+			tmp = end;
+
+		/* Here vma->vm_start <= start < tmp <= (end|vma->vm_end). */
+		error = madvise_vma(vma, &prev, start, tmp, behavior);
+		if (error)
+			goto out;
+		start = tmp;
+		if (prev && start < prev->vm_end)
+			start = prev->vm_end;
+		error = unmapped_error;
+		if (start >= end)
+			goto out;
+		if (prev)
+			vma = prev->vm_next;
+		else	/* madvise_remove dropped mmap_lock */
+			vma = find_vma(mm, start);
+	}
+out:
+	*advised = (error ? min(failed, start) : end) - orig_start;
+	return error;
+}
+
 /*
  * The madvise(2) system call.
  *
@@ -1046,6 +1231,10 @@ process_madvise_behavior_valid(int behavior)
  *		easily if memory pressure hanppens.
  *  MADV_PAGEOUT - the application is not expected to use this memory soon,
  *		page out the pages in this range immediately.
+ *  MADV_POPULATE_READ - populate (prefault) page tables readable by
+ *		triggering read faults if required
+ *  MADV_POPULATE_WRITE - populate (prefault) page tables writable by
+ *		triggering write faults if required
  *
  * return values:
  *  zero    - success
@@ -1059,36 +1248,23 @@ process_madvise_behavior_valid(int behavior)
  *  -EIO    - an I/O error occurred while paging in data.
  *  -EBADF  - map exists, but area maps something that isn't a file.
  *  -EAGAIN - a kernel resource was temporarily unavailable.
+ *  -EHWPOISON - MADV_POPULATE_(READ|WRITE) hit a hardware poisoned page.
  */
 int do_madvise(struct mm_struct *mm, unsigned long start, size_t len_in, int behavior)
 {
-	unsigned long end, tmp;
-	struct vm_area_struct *vma, *prev;
-	int unmapped_error = 0;
-	int error = -EINVAL;
+	unsigned long end;
+	int error;
 	int write;
-	size_t len;
+	size_t advised;
 	struct blk_plug plug;
 
 	start = untagged_addr(start);
 
 	if (!madvise_behavior_valid(behavior))
-		return error;
-
-	if (!PAGE_ALIGNED(start))
-		return error;
-	len = PAGE_ALIGN(len_in);
-
-	/* Check to see whether len was rounded up from small -ve to zero */
-	if (len_in && !len)
-		return error;
-
-	end = start + len;
-	if (end < start)
-		return error;
+		return -EINVAL;
 
-	error = 0;
-	if (end == start)
+	error = madvise_range(start, len_in, &end);
+	if (error || end == start)
 		return error;
 
 #ifdef CONFIG_MEMORY_FAILURE
@@ -1104,51 +1280,8 @@ int do_madvise(struct mm_struct *mm, unsigned long start, size_t len_in, int beh
 		mmap_read_lock(mm);
 	}
 
-	/*
-	 * If the interval [start,end) covers some unmapped address
-	 * ranges, just ignore them, but return -ENOMEM at the end.
-	 * - different from the way of handling in mlock etc.
-	 */
-	vma = find_vma_prev(mm, start, &prev);
-	if (vma && start > vma->vm_start)
-		prev = vma;
-
 	blk_start_plug(&plug);
-	for (;;) {
-		/* Still start < end. */
-		error = -ENOMEM;
-		if (!vma)
-			goto out;
-
-		/* Here start < (end|vma->vm_end). */
-		if (start < vma->vm_start) {
-			unmapped_error = -ENOMEM;
-			start = vma->vm_start;
-			if (start >= end)
-				goto out;
-		}
-
-		/* Here vma->vm_start <= start < (end|vma->vm_end) */
-		tmp = vma->vm_end;
-		if (end < tmp)
-			tmp = end;
-
-		/* Here vma->vm_start <= start < tmp <= (end|vma->vm_end). */
-		error = madvise_vma(vma, &prev, start, tmp, behavior);
-		if (error)
-			goto out;
-		start = tmp;
-		if (prev && start < prev->vm_end)
-			start = prev->vm_end;
-		error = unmapped_error;
-		if (start >= end)
-			goto out;
-		if (prev)
-			vma = prev->vm_next;
-		else	/* madvise_remove dropped mmap_lock */
-			vma = find_vma(mm, start);
-	}
-out:
+	error = madvise_walk_vmas(mm, start, end, behavior, &advised);
 	blk_finish_plug(&plug);
 	if (write)
 		mmap_write_unlock(mm);
@@ -1163,20 +1296,55 @@ SYSCALL_DEFINE3(madvise, unsigned long, start, size_t, len_in, int, behavior)
 	return do_madvise(current->mm, start, len_in, behavior);
 }
 
+/*
+ * Write the number of bytes advised in each range back to the iov_len of
+ * the user's iovec, for PMADV_PER_RANGE.
+ */
+static int process_madvise_report(const struct iovec __user *uvec,
+				  const struct iovec *ranges,
+				  unsigned long nr_ranges)
+{
+	struct iovec __user *vec = (struct iovec __user *)uvec;
+	unsigned long i;
+
+	for (i = 0; i < nr_ranges; i++) {
+#ifdef CONFIG_COMPAT
+		if (in_compat_syscall()) {
+			struct compat_iovec __user *cvec =
+				(struct compat_iovec __user *)vec;
+
+			if (put_user((compat_size_t)ranges[i].iov_len,
+				     &cvec[i].iov_len))
+				return -EFAULT;
+			continue;
+		}
+#endif
+		if (put_user(ranges[i].iov_len, &vec[i].iov_len))
+			return -EFAULT;
+	}
+
+	return 0;
+}
+
 SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
 		size_t, vlen, int, behavior, unsigned int, flags)
 {
 	ssize_t ret;
-	struct iovec iovstack[UIO_FASTIOV], iovec;
-	struct iovec *iov = iovstack;
+	struct iovec iovstack[UIO_FASTIOV];
+	struct iovec *iov = iovstack, *ranges;
 	struct iov_iter iter;
 	struct pid *pid;
 	struct task_struct *task;
 	struct mm_struct *mm;
-	size_t total_len;
+	struct blk_plug plug;
+	unsigned long i, nr_ranges, start, end;
+	size_t total = 0, advised;
 	unsigned int f_flags;
+	int error = 0, first_error = 0;
+	bool per_range;
+	int write;
 
-	if (flags != 0) {
+	if (flags & ~PMADV_PER_RANGE) {
 		ret = -EINVAL;
 		goto out;
 	}
@@ -1184,6 +1352,8 @@ SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
 	ret = import_iovec(READ, vec, vlen, ARRAY_SIZE(iovstack), &iov, &iter);
 	if (ret < 0)
 		goto out;
+	ranges = iov ?: iovstack;
+	nr_ranges = iter.nr_segs;
 
 	pid = pidfd_get_pid(pidfd, &f_flags);
 	if (IS_ERR(pid)) {
@@ -1218,19 +1388,79 @@ SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
 		goto release_mm;
 	}
 
-	total_len = iov_iter_count(&iter);
+	/*
+	 * The mmap_lock is taken once for the whole vector, except for the
+	 * populate hints: holding it across all their faults would stall the
+	 * target's own faults and mmap calls for as long, so they take it
+	 * per range.
+	 */
+	write = madvise_need_mmap_write(behavior);
+	per_range = behavior == MADV_POPULATE_READ;
+	if (!per_range && madvise_lock(mm, write)) {
+		ret = -EINTR;
+		goto release_mm;
+	}
 
-	while (iov_iter_count(&iter)) {
-		iovec = iov_iter_iovec(&iter);
-		ret = do_madvise(mm, (unsigned long)iovec.iov_base,
-					iovec.iov_len, behavior);
-		if (ret < 0)
+	blk_start_plug(&plug);
+	for (i = 0; i < nr_ranges; i++) {
+		if (fatal_signal_pending(current)) {
+			error = -EINTR;
+			if (!first_error)
+				first_error = error;
 			break;
-		iov_iter_advance(&iter, iovec.iov_len);
+		}
+
+		advised = 0;
+		start = untagged_addr((unsigned long)ranges[i].iov_base);
+		error = madvise_range(start, ranges[i].iov_len, &end);
+		if (!error && end > start) {
+			if (per_range && madvise_lock(mm, write)) {
+				error = -EINTR;
+				if (!first_error)
+					first_error = error;
+				break;
+			}
+			error = madvise_walk_vmas(mm, start, end, behavior,
+						  &advised);
+			if (per_range)
+				madvise_unlock(mm, write);
+		}
+		/* Report in the caller's units, not rounded up to pages */
+		if (!error)
+			advised = ranges[i].iov_len;
+		else
+			advised = min(advised, ranges[i].iov_len);
+
+		ranges[i].iov_len = advised;
+		total += advised;
+		if (error) {
+			if (!first_error)
+				first_error = error;
+			if (!(flags & PMADV_PER_RANGE))
+				break;
+		}
+		cond_resched();
 	}
+	blk_finish_plug(&plug);
+	if (!per_range)
+		madvise_unlock(mm, write);
 
-	if (ret == 0)
-		ret = total_len - iov_iter_count(&iter);
+	/*
+	 * Without PMADV_PER_RANGE, keep returning the first error as the
+	 * single range interface always did.  With it, the caller finds the
+	 * failed ranges in the iovec and only sees an error if nothing at
+	 * all could be advised.
+	 */
+	if (flags & PMADV_PER_RANGE) {
+		if (error == -EINTR)
+			for (; i < nr_ranges; i++)
+				ranges[i].iov_len = 0;
+		ret = process_madvise_report(vec, ranges, nr_ranges);
+		if (!ret)
+			ret = total ? total : first_error;
+	} else {
+		ret = first_error ? first_error : total;
+	}
 
 release_mm:
 	mmput(mm);
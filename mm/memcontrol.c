@@ -59,6 +59,7 @@
 #include <linux/tracehook.h>
 #include <linux/psi.h>
 #include <linux/seq_buf.h>
+#include <linux/parser.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
@@ -266,14 +267,14 @@ static void obj_cgroup_release(struct percpu_ref *ref)
 	 * However, it can be PAGE_SIZE or (x * PAGE_SIZE).
 	 *
 	 * The following sequence can lead to it:
-	 * 1) CPU0: objcg == stock->cached_objcg
+	 * 1) CPU0: objcg is cached in one of the obj stock entries
 	 * 2) CPU1: we do a small allocation (e.g. 92 bytes),
 	 *          PAGE_SIZE bytes are charged
 	 * 3) CPU1: a process from another memcg is allocating something,
 	 *          the stock if flushed,
 	 *          objcg->nr_charged_bytes = PAGE_SIZE - 92
 	 * 5) CPU0: we do release this object,
-	 *          92 bytes are added to stock->nr_bytes
+	 *          92 bytes are added to the entry's nr_bytes
 	 * 6) CPU0: stock is flushed,
 	 *          92 bytes are added to objcg->nr_charged_bytes
 	 *
@@ -763,6 +764,119 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
 	return mz;
 }
 
+/*
+ * memcg and lruvec stats flushing
+ *
+ * Many codepaths leading to stats update or read are performance sensitive
+ * and adding stats flushing in such codepaths is not desirable. So, to
+ * optimize the flushing the kernel does:
+ *
+ * 1) Periodically and asynchronously flush the stats every
+ *    stats_flush_interval_ms so that the stats are never more stale
+ *    than that, no matter how many cgroups there are.
+ *
+ * 2) Flush the stats synchronously on the reader side only when there
+ *    are more than (MEMCG_CHARGE_BATCH * nr_cpus) update events. Though
+ *    this optimization will let stats be out of sync by at most
+ *    (MEMCG_CHARGE_BATCH * nr_cpus) but only for a short amount of time.
+ *
+ * Updates only touch per-cpu counters and mark the cgroup on the rstat
+ * updated tree; readers of memcg_page_state() and memcg_events() are O(1).
+ */
+static void flush_memcg_stats_dwork(struct work_struct *w);
+static DECLARE_DEFERRABLE_WORK(stats_flush_dwork, flush_memcg_stats_dwork);
+static DEFINE_SPINLOCK(stats_flush_lock);
+static DEFINE_PER_CPU(unsigned int, stats_updates);
+static atomic_t stats_flush_threshold = ATOMIC_INIT(0);
+
+static unsigned int stats_flush_interval_ms = 2000;
+
+static int stats_flush_interval_set(const char *val,
+				    const struct kernel_param *kp)
+{
+	unsigned int ms;
+	int ret;
+
+	ret = kstrtouint(val, 0, &ms);
+	if (ret)
+		return ret;
+	if (!ms)
+		return -EINVAL;
+
+	WRITE_ONCE(stats_flush_interval_ms, ms);
+	/*
+	 * Apply the new staleness bound right away.  Not when set on the
+	 * command line, before workqueues exist: the first flush, queued when
+	 * the root memcg comes online, uses the boot value anyway.
+	 */
+	if (system_unbound_wq)
+		mod_delayed_work(system_unbound_wq, &stats_flush_dwork, 0);
+	return 0;
+}
+
+static const struct kernel_param_ops stats_flush_interval_ops = {
+	.set = stats_flush_interval_set,
+	.get = param_get_uint,
+};
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "memcg."
+module_param_cb(stats_flush_interval_ms, &stats_flush_interval_ops,
+		&stats_flush_interval_ms, 0644);
+
+/* @nr is the size of the update in pages (or events) */
+static inline void memcg_rstat_updated(struct mem_cgroup *memcg,
+				       unsigned int nr)
+{
+	unsigned int x;
+
+	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
+
+	x = __this_cpu_add_return(stats_updates, nr);
+	if (x > MEMCG_CHARGE_BATCH) {
+		atomic_add(x / MEMCG_CHARGE_BATCH, &stats_flush_threshold);
+		__this_cpu_write(stats_updates, 0);
+	}
+}
+
+static void __mem_cgroup_flush_stats(void)
+{
+	unsigned long flag;
+
+	/*
+	 * A flush in progress brings everything up to date for us as
+	 * well; don't pile up behind it on cgroup_rstat_lock.
+	 */
+	if (!spin_trylock_irqsave(&stats_flush_lock, flag))
+		return;
+
+	cgroup_rstat_flush_irqsafe(root_mem_cgroup->css.cgroup);
+	atomic_set(&stats_flush_threshold, 0);
+	spin_unlock_irqrestore(&stats_flush_lock, flag);
+}
+
+/**
+ * mem_cgroup_flush_stats - bring memcg_page_state() and friends up to date
+ *
+ * Only flushes when enough updates have been batched up on the per-cpu
+ * counters to make the aggregated values noticeably inaccurate, so it is
+ * cheap to call from stat readers.
+ */
+void mem_cgroup_flush_stats(void)
+{
+	if (mem_cgroup_disabled())
+		return;
+	if (atomic_read(&stats_flush_threshold) > num_online_cpus())
+		__mem_cgroup_flush_stats();
+}
+
+static void flush_memcg_stats_dwork(struct work_struct *w)
+{
+	__mem_cgroup_flush_stats();
+	queue_delayed_work(system_unbound_wq, &stats_flush_dwork,
+			   msecs_to_jiffies(READ_ONCE(stats_flush_interval_ms)));
+}
+
 /**
  * __mod_memcg_state - update cgroup memory statistics
  * @memcg: the memory cgroup
@@ -771,28 +885,14 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
  */
 void __mod_memcg_state(struct mem_cgroup *memcg, int idx, int val)
 {
-	long x, threshold = MEMCG_CHARGE_BATCH;
-
 	if (mem_cgroup_disabled())
 		return;
 
+	__this_cpu_add(memcg->vmstats_percpu->state[idx], val);
 	if (memcg_stat_item_in_bytes(idx))
-		threshold <<= PAGE_SHIFT;
-
-	x = val + __this_cpu_read(memcg->vmstats_percpu->stat[idx]);
-	if (unlikely(abs(x) > threshold)) {
-		struct mem_cgroup *mi;
-
-		/*
-		 * Batch local counters to keep them in sync with
-		 * the hierarchical ones.
-		 */
-		__this_cpu_add(memcg->vmstats_local->stat[idx], x);
-		for (mi = memcg; mi; mi = parent_mem_cgroup(mi))
-			atomic_long_add(x, &mi->vmstats[idx]);
-		x = 0;
-	}
-	__this_cpu_write(memcg->vmstats_percpu->stat[idx], x);
+		memcg_rstat_updated(memcg, DIV_ROUND_UP(abs(val), PAGE_SIZE));
+	else
+		memcg_rstat_updated(memcg, abs(val));
 }
 
 static struct mem_cgroup_per_node *
@@ -902,30 +1002,16 @@ void mod_memcg_obj_state(void *p, int idx, int val)
 void __count_memcg_events(struct mem_cgroup *memcg, enum vm_event_item idx,
 			  unsigned long count)
 {
-	unsigned long x;
-
 	if (mem_cgroup_disabled())
 		return;
 
-	x = count + __this_cpu_read(memcg->vmstats_percpu->events[idx]);
-	if (unlikely(x > MEMCG_CHARGE_BATCH)) {
-		struct mem_cgroup *mi;
-
-		/*
-		 * Batch local counters to keep them in sync with
-		 * the hierarchical ones.
-		 */
-		__this_cpu_add(memcg->vmstats_local->events[idx], x);
-		for (mi = memcg; mi; mi = parent_mem_cgroup(mi))
-			atomic_long_add(x, &mi->vmevents[idx]);
-		x = 0;
-	}
-	__this_cpu_write(memcg->vmstats_percpu->events[idx], x);
+	__this_cpu_add(memcg->vmstats_percpu->events[idx], count);
+	memcg_rstat_updated(memcg, count);
 }
 
 static unsigned long memcg_events(struct mem_cgroup *memcg, int event)
 {
-	return atomic_long_read(&memcg->vmevents[event]);
+	return READ_ONCE(memcg->vmstats.events[event]);
 }
 
 static unsigned long memcg_events_local(struct mem_cgroup *memcg, int event)
@@ -934,7 +1020,7 @@ static unsigned long memcg_events_local(struct mem_cgroup *memcg, int event)
 	int cpu;
 
 	for_each_possible_cpu(cpu)
-		x += per_cpu(memcg->vmstats_local->events[event], cpu);
+		x += per_cpu(memcg->vmstats_percpu->events[event], cpu);
 	return x;
 }
 
@@ -1497,6 +1583,10 @@ static struct memory_stat memory_stats[] = {
 	{ "kernel_stack", 1024, NR_KERNEL_STACK_KB },
 	{ "percpu", 1, MEMCG_PERCPU_B },
 	{ "sock", PAGE_SIZE, MEMCG_SOCK },
+#ifdef CONFIG_ZSWAP
+	{ "zswap", 1, MEMCG_ZSWAP_B },
+	{ "zswapped", PAGE_SIZE, MEMCG_ZSWAPPED },
+#endif
 	{ "shmem", PAGE_SIZE, NR_SHMEM },
 	{ "file_mapped", PAGE_SIZE, NR_FILE_MAPPED },
 	{ "file_dirty", PAGE_SIZE, NR_FILE_DIRTY },
@@ -1530,6 +1620,8 @@ static struct memory_stat memory_stats[] = {
 	{ "workingset_restore_anon", 1, WORKINGSET_RESTORE_ANON },
 	{ "workingset_restore_file", 1, WORKINGSET_RESTORE_FILE },
 	{ "workingset_nodereclaim", 1, WORKINGSET_NODERECLAIM },
+	{ "file_dirtied", 1, NR_DIRTIED },
+	{ "file_written", 1, NR_WRITTEN },
 };
 
 static int __init memory_stats_init(void)
@@ -1558,6 +1650,8 @@ static char *memory_stat_format(struct mem_cgroup *memcg)
 	if (!s.buffer)
 		return NULL;
 
+	mem_cgroup_flush_stats();
+
 	/*
 	 * Provide statistics on the state of the memory subsystem as
 	 * well as cumulative event counters that show past behavior.
@@ -1606,6 +1700,24 @@ static char *memory_stat_format(struct mem_cgroup *memcg)
 	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGLAZYFREED),
 		       memcg_events(memcg, PGLAZYFREED));
 
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(DIRTY_PAUSE_4MS),
+		       memcg_events(memcg, DIRTY_PAUSE_4MS));
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(DIRTY_PAUSE_16MS),
+		       memcg_events(memcg, DIRTY_PAUSE_16MS));
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(DIRTY_PAUSE_64MS),
+		       memcg_events(memcg, DIRTY_PAUSE_64MS));
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(DIRTY_PAUSE_LONG),
+		       memcg_events(memcg, DIRTY_PAUSE_LONG));
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(DIRTY_PAUSE_MS),
+		       memcg_events(memcg, DIRTY_PAUSE_MS));
+
+#ifdef CONFIG_SWAP
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(SWAP_RA),
+		       memcg_events(memcg, SWAP_RA));
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(SWAP_RA_HIT),
+		       memcg_events(memcg, SWAP_RA_HIT));
+#endif
+
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	seq_buf_printf(&s, "%s %lu\n", vm_event_name(THP_FAULT_ALLOC),
 		       memcg_events(memcg, THP_FAULT_ALLOC));
@@ -2199,13 +2311,30 @@ void unlock_page_memcg(struct page *page)
 }
 EXPORT_SYMBOL(unlock_page_memcg);
 
+#ifdef CONFIG_MEMCG_KMEM
+/*
+ * Number of obj_cgroups whose byte charges and slab vmstat deltas are
+ * cached on each cpu. With a single entry, tasks from different cgroups
+ * sharing a cpu keep draining each other's stock on every allocation.
+ */
+#define NR_OBJ_STOCK	4
+
+struct obj_stock {
+	struct obj_cgroup *cached_objcg;
+	struct pglist_data *cached_pgdat;
+	unsigned int nr_bytes;
+	int nr_slab_reclaimable_b;
+	int nr_slab_unreclaimable_b;
+};
+#endif
+
 struct memcg_stock_pcp {
 	struct mem_cgroup *cached; /* this never be root cgroup */
 	unsigned int nr_pages;
 
 #ifdef CONFIG_MEMCG_KMEM
-	struct obj_cgroup *cached_objcg;
-	unsigned int nr_bytes;
+	struct obj_stock obj[NR_OBJ_STOCK];
+	unsigned int obj_victim;	/* next entry to evict */
 #endif
 
 	struct work_struct work;
@@ -2376,26 +2505,23 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 static int memcg_hotplug_cpu_dead(unsigned int cpu)
 {
 	struct memcg_stock_pcp *stock;
-	struct mem_cgroup *memcg, *mi;
+	struct mem_cgroup *memcg;
 
 	stock = &per_cpu(memcg_stock, cpu);
+	/* cached slab vmstat deltas are folded into this cpu's counters */
+	local_irq_disable();
+	drain_obj_stock(stock);
+	local_irq_enable();
 	drain_stock(stock);
 
+	/* memcg stats and events of @cpu are picked up by the next rstat flush */
 	for_each_mem_cgroup(memcg) {
 		int i;
 
-		for (i = 0; i < MEMCG_NR_STAT; i++) {
+		for (i = 0; i < NR_VM_NODE_STAT_ITEMS; i++) {
 			int nid;
 			long x;
 
-			x = this_cpu_xchg(memcg->vmstats_percpu->stat[i], 0);
-			if (x)
-				for (mi = memcg; mi; mi = parent_mem_cgroup(mi))
-					atomic_long_add(x, &memcg->vmstats[i]);
-
-			if (i >= NR_VM_NODE_STAT_ITEMS)
-				continue;
-
 			for_each_node(nid) {
 				struct mem_cgroup_per_node *pn;
 
@@ -2407,15 +2533,6 @@ static int memcg_hotplug_cpu_dead(unsigned int cpu)
 					} while ((pn = parent_nodeinfo(pn, nid)));
 			}
 		}
-
-		for (i = 0; i < NR_VM_EVENT_ITEMS; i++) {
-			long x;
-
-			x = this_cpu_xchg(memcg->vmstats_percpu->events[i], 0);
-			if (x)
-				for (mi = memcg; mi; mi = parent_mem_cgroup(mi))
-					atomic_long_add(x, &memcg->vmevents[i]);
-		}
 	}
 
 	return 0;
@@ -2887,34 +3004,6 @@ static void commit_charge(struct page *page, struct mem_cgroup *memcg)
 }
 
 #ifdef CONFIG_MEMCG_KMEM
-/*
- * The allocated objcg pointers array is not accounted directly.
- * Moreover, it should not come from DMA buffer and is not readily
- * reclaimable. So those GFP bits should be masked off.
- */
-#define OBJCGS_CLEAR_MASK	(__GFP_DMA | __GFP_RECLAIMABLE | __GFP_ACCOUNT)
-
-int memcg_alloc_page_obj_cgroups(struct page *page, struct kmem_cache *s,
-				 gfp_t gfp)
-{
-	unsigned int objects = objs_per_slab_page(s, page);
-	void *vec;
-
-	gfp &= ~OBJCGS_CLEAR_MASK;
-	vec = kcalloc_node(objects, sizeof(struct obj_cgroup *), gfp,
-			   page_to_nid(page));
-	if (!vec)
-		return -ENOMEM;
-
-	if (cmpxchg(&page->obj_cgroups, NULL,
-		    (struct obj_cgroup **) ((unsigned long)vec | 0x1UL)))
-		kfree(vec);
-	else
-		kmemleak_not_leak(vec);
-
-	return 0;
-}
-
 /*
  * Returns a pointer to the memory cgroup to which the kernel object is charged.
  *
@@ -2944,14 +3033,14 @@ struct mem_cgroup *mem_cgroup_from_obj(void *p)
 	/*
 	 * Slab objects are accounted individually, not per-page.
 	 * Memcg membership data for each individual object is saved in
-	 * the page->obj_cgroups.
+	 * the page->obj_exts.
 	 */
-	if (page_has_obj_cgroups(page)) {
+	if (page_has_obj_exts(page)) {
 		struct obj_cgroup *objcg;
 		unsigned int off;
 
 		off = obj_to_index(page->slab_cache, page, p);
-		objcg = page_obj_cgroups(page)[off];
+		objcg = page_obj_exts(page)[off].objcg;
 		if (objcg)
 			return obj_cgroup_memcg(objcg);
 
@@ -2987,6 +3076,35 @@ __always_inline struct obj_cgroup *get_obj_cgroup_from_current(void)
 	return objcg;
 }
 
+#ifdef CONFIG_ZSWAP
+/*
+ * Returns a reference to the objcg of the memcg that @page is charged to,
+ * so that memory allocated on behalf of the page, like its compressed copy
+ * in zswap, can be accounted to the same cgroup.
+ */
+struct obj_cgroup *get_obj_cgroup_from_page(struct page *page)
+{
+	struct obj_cgroup *objcg = NULL;
+	struct mem_cgroup *memcg;
+
+	if (!memcg_kmem_enabled())
+		return NULL;
+
+	rcu_read_lock();
+	memcg = READ_ONCE(page->mem_cgroup);
+	for (; memcg && memcg != root_mem_cgroup;
+	     memcg = parent_mem_cgroup(memcg)) {
+		objcg = rcu_dereference(memcg->objcg);
+		if (objcg && obj_cgroup_tryget(objcg))
+			break;
+		objcg = NULL;
+	}
+	rcu_read_unlock();
+
+	return objcg;
+}
+#endif
+
 static int memcg_alloc_cache_id(void)
 {
 	int id, size;
@@ -3128,49 +3246,65 @@ void __memcg_kmem_uncharge_page(struct page *page, int order)
 		__ClearPageKmemcg(page);
 }
 
-static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
+static void mod_objcg_lruvec_state(struct obj_cgroup *objcg,
+				   struct pglist_data *pgdat,
+				   enum node_stat_item idx, int nr)
 {
-	struct memcg_stock_pcp *stock;
-	unsigned long flags;
-	bool ret = false;
+	struct mem_cgroup *memcg;
+	struct lruvec *lruvec;
 
-	local_irq_save(flags);
+	rcu_read_lock();
+	memcg = obj_cgroup_memcg(objcg);
+	lruvec = mem_cgroup_lruvec(memcg, pgdat);
+	__mod_memcg_lruvec_state(lruvec, idx, nr);
+	rcu_read_unlock();
+}
 
-	stock = this_cpu_ptr(&memcg_stock);
-	if (objcg == stock->cached_objcg && stock->nr_bytes >= nr_bytes) {
-		stock->nr_bytes -= nr_bytes;
-		ret = true;
+static void flush_obj_stock_stats(struct obj_stock *os)
+{
+	if (os->nr_slab_reclaimable_b) {
+		mod_objcg_lruvec_state(os->cached_objcg, os->cached_pgdat,
+				       NR_SLAB_RECLAIMABLE_B,
+				       os->nr_slab_reclaimable_b);
+		os->nr_slab_reclaimable_b = 0;
+	}
+	if (os->nr_slab_unreclaimable_b) {
+		mod_objcg_lruvec_state(os->cached_objcg, os->cached_pgdat,
+				       NR_SLAB_UNRECLAIMABLE_B,
+				       os->nr_slab_unreclaimable_b);
+		os->nr_slab_unreclaimable_b = 0;
 	}
+}
 
-	local_irq_restore(flags);
+static void obj_cgroup_uncharge_pages(struct obj_cgroup *objcg,
+				      unsigned int nr_pages)
+{
+	struct mem_cgroup *memcg;
 
-	return ret;
+	rcu_read_lock();
+retry:
+	memcg = obj_cgroup_memcg(objcg);
+	if (unlikely(!css_tryget(&memcg->css)))
+		goto retry;
+	rcu_read_unlock();
+
+	__memcg_kmem_uncharge(memcg, nr_pages);
+	css_put(&memcg->css);
 }
 
-static void drain_obj_stock(struct memcg_stock_pcp *stock)
+static void __drain_obj_stock(struct obj_stock *os)
 {
-	struct obj_cgroup *old = stock->cached_objcg;
+	struct obj_cgroup *old = os->cached_objcg;
 
 	if (!old)
 		return;
 
-	if (stock->nr_bytes) {
-		unsigned int nr_pages = stock->nr_bytes >> PAGE_SHIFT;
-		unsigned int nr_bytes = stock->nr_bytes & (PAGE_SIZE - 1);
+	if (os->nr_bytes) {
+		unsigned int nr_pages = os->nr_bytes >> PAGE_SHIFT;
+		unsigned int nr_bytes = os->nr_bytes & (PAGE_SIZE - 1);
 
-		if (nr_pages) {
-			struct mem_cgroup *memcg;
-
-			rcu_read_lock();
-retry:
-			memcg = obj_cgroup_memcg(old);
-			if (unlikely(!css_tryget(&memcg->css)))
-				goto retry;
-			rcu_read_unlock();
-
-			__memcg_kmem_uncharge(memcg, nr_pages);
-			css_put(&memcg->css);
-		}
+		if (nr_pages)
+			obj_cgroup_uncharge_pages(old, nr_pages);
 
 		/*
 		 * The leftover is flushed to the centralized per-memcg value.
@@ -3183,20 +3317,137 @@ retry:
 		 * so it might be changed in the future.
 		 */
 		atomic_add(nr_bytes, &old->nr_charged_bytes);
-		stock->nr_bytes = 0;
+		os->nr_bytes = 0;
+	}
+
+	if (os->cached_pgdat) {
+		flush_obj_stock_stats(os);
+		os->cached_pgdat = NULL;
 	}
 
 	obj_cgroup_put(old);
-	stock->cached_objcg = NULL;
+	os->cached_objcg = NULL;
+}
+
+static void drain_obj_stock(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < NR_OBJ_STOCK; i++)
+		__drain_obj_stock(&stock->obj[i]);
+}
+
+/*
+ * Look up the entry caching @objcg on this cpu. If @add is set and there
+ * is none, take over a free entry or evict the oldest one, round-robin.
+ */
+static struct obj_stock *get_obj_stock(struct memcg_stock_pcp *stock,
+				       struct obj_cgroup *objcg, bool add)
+{
+	struct obj_stock *os, *free = NULL;
+	int i;
+
+	for (i = 0; i < NR_OBJ_STOCK; i++) {
+		os = &stock->obj[i];
+		if (os->cached_objcg == objcg)
+			return os;
+		if (!free && !os->cached_objcg)
+			free = os;
+	}
+
+	if (!add)
+		return NULL;
+
+	if (!free) {
+		free = &stock->obj[stock->obj_victim];
+		stock->obj_victim = (stock->obj_victim + 1) % NR_OBJ_STOCK;
+		__drain_obj_stock(free);
+	}
+
+	obj_cgroup_get(objcg);
+	free->cached_objcg = objcg;
+	free->nr_bytes = atomic_xchg(&objcg->nr_charged_bytes, 0);
+	return free;
+}
+
+/*
+ * Slab vmstat updates are batched in the obj stock as well, and only
+ * pushed out to the memcg and lruvec counters once they accumulate a
+ * page worth of bytes or the stock is drained.
+ */
+void mod_objcg_state(struct obj_cgroup *objcg, struct pglist_data *pgdat,
+		     enum node_stat_item idx, int nr)
+{
+	struct memcg_stock_pcp *stock;
+	struct obj_stock *os;
+	unsigned long flags;
+	int *bytes;
+
+	local_irq_save(flags);
+
+	stock = this_cpu_ptr(&memcg_stock);
+	os = get_obj_stock(stock, objcg, true);
+
+	if (os->cached_pgdat != pgdat) {
+		flush_obj_stock_stats(os);
+		os->cached_pgdat = pgdat;
+	}
+
+	if (idx == NR_SLAB_RECLAIMABLE_B)
+		bytes = &os->nr_slab_reclaimable_b;
+	else if (idx == NR_SLAB_UNRECLAIMABLE_B)
+		bytes = &os->nr_slab_unreclaimable_b;
+	else
+		bytes = NULL;
+
+	if (bytes) {
+		*bytes += nr;
+		if (abs(*bytes) > PAGE_SIZE) {
+			nr = *bytes;
+			*bytes = 0;
+		} else {
+			nr = 0;
+		}
+	}
+	if (nr)
+		mod_objcg_lruvec_state(objcg, pgdat, idx, nr);
+
+	local_irq_restore(flags);
+}
+
+static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
+{
+	struct memcg_stock_pcp *stock;
+	struct obj_stock *os;
+	unsigned long flags;
+	bool ret = false;
+
+	local_irq_save(flags);
+
+	stock = this_cpu_ptr(&memcg_stock);
+	os = get_obj_stock(stock, objcg, false);
+	if (os && os->nr_bytes >= nr_bytes) {
+		os->nr_bytes -= nr_bytes;
+		ret = true;
+	}
+
+	local_irq_restore(flags);
+
+	return ret;
 }
 
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 				     struct mem_cgroup *root_memcg)
 {
 	struct mem_cgroup *memcg;
+	int i;
+
+	for (i = 0; i < NR_OBJ_STOCK; i++) {
+		struct obj_cgroup *objcg = stock->obj[i].cached_objcg;
 
-	if (stock->cached_objcg) {
-		memcg = obj_cgroup_memcg(stock->cached_objcg);
+		if (!objcg)
+			continue;
+		memcg = obj_cgroup_memcg(objcg);
 		if (memcg && mem_cgroup_is_descendant(memcg, root_memcg))
 			return true;
 	}
@@ -3207,21 +3458,20 @@ static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 static void refill_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
 {
 	struct memcg_stock_pcp *stock;
+	struct obj_stock *os;
 	unsigned long flags;
 
 	local_irq_save(flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (stock->cached_objcg != objcg) { /* reset if necessary */
-		drain_obj_stock(stock);
-		obj_cgroup_get(objcg);
-		stock->cached_objcg = objcg;
-		stock->nr_bytes = atomic_xchg(&objcg->nr_charged_bytes, 0);
-	}
-	stock->nr_bytes += nr_bytes;
+	os = get_obj_stock(stock, objcg, true);
+	os->nr_bytes += nr_bytes;
 
-	if (stock->nr_bytes > PAGE_SIZE)
-		drain_obj_stock(stock);
+	/* Give back whole pages but keep the entry and its cached stats */
+	if (os->nr_bytes > PAGE_SIZE) {
+		obj_cgroup_uncharge_pages(objcg, os->nr_bytes >> PAGE_SHIFT);
+		os->nr_bytes &= PAGE_SIZE - 1;
+	}
 
 	local_irq_restore(flags);
 }
@@ -3572,6 +3822,7 @@ static unsigned long mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 	unsigned long val;
 
 	if (mem_cgroup_is_root(memcg)) {
+		mem_cgroup_flush_stats();
 		val = memcg_page_state(memcg, NR_FILE_PAGES) +
 			memcg_page_state(memcg, NR_ANON_MAPPED);
 		if (swap)
@@ -3636,26 +3887,15 @@ static u64 mem_cgroup_read_u64(struct cgroup_subsys_state *css,
 	}
 }
 
-static void memcg_flush_percpu_vmstats(struct mem_cgroup *memcg)
+static void memcg_flush_lruvec_page_state(struct mem_cgroup *memcg)
 {
-	unsigned long stat[MEMCG_NR_STAT] = {0};
-	struct mem_cgroup *mi;
-	int node, cpu, i;
-
-	for_each_online_cpu(cpu)
-		for (i = 0; i < MEMCG_NR_STAT; i++)
-			stat[i] += per_cpu(memcg->vmstats_percpu->stat[i], cpu);
-
-	for (mi = memcg; mi; mi = parent_mem_cgroup(mi))
-		for (i = 0; i < MEMCG_NR_STAT; i++)
-			atomic_long_add(stat[i], &mi->vmstats[i]);
+	int node;
 
 	for_each_node(node) {
 		struct mem_cgroup_per_node *pn = memcg->nodeinfo[node];
+		unsigned long stat[NR_VM_NODE_STAT_ITEMS] = {0};
 		struct mem_cgroup_per_node *pi;
-
-		for (i = 0; i < NR_VM_NODE_STAT_ITEMS; i++)
-			stat[i] = 0;
+		int cpu, i;
 
 		for_each_online_cpu(cpu)
 			for (i = 0; i < NR_VM_NODE_STAT_ITEMS; i++)
@@ -3668,25 +3908,6 @@ static void memcg_flush_percpu_vmstats(struct mem_cgroup *memcg)
 	}
 }
 
-static void memcg_flush_percpu_vmevents(struct mem_cgroup *memcg)
-{
-	unsigned long events[NR_VM_EVENT_ITEMS];
-	struct mem_cgroup *mi;
-	int cpu, i;
-
-	for (i = 0; i < NR_VM_EVENT_ITEMS; i++)
-		events[i] = 0;
-
-	for_each_online_cpu(cpu)
-		for (i = 0; i < NR_VM_EVENT_ITEMS; i++)
-			events[i] += per_cpu(memcg->vmstats_percpu->events[i],
-					     cpu);
-
-	for (mi = memcg; mi; mi = parent_mem_cgroup(mi))
-		for (i = 0; i < NR_VM_EVENT_ITEMS; i++)
-			atomic_long_add(events[i], &mi->vmevents[i]);
-}
-
 #ifdef CONFIG_MEMCG_KMEM
 static int memcg_online_kmem(struct mem_cgroup *memcg)
 {
@@ -4011,6 +4232,8 @@ static int memcg_numa_stat_show(struct seq_file *m, void *v)
 	int nid;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
+	mem_cgroup_flush_stats();
+
 	for (stat = stats; stat < stats + ARRAY_SIZE(stats); stat++) {
 		seq_printf(m, "%s=%lu", stat->name,
 			   mem_cgroup_nr_lru_pages(memcg, stat->lru_mask,
@@ -4081,6 +4304,8 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 
+	mem_cgroup_flush_stats();
+
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		unsigned long nr;
 
@@ -4565,22 +4790,6 @@ struct wb_domain *mem_cgroup_wb_domain(struct bdi_writeback *wb)
 	return &memcg->cgwb_domain;
 }
 
-/*
- * idx can be of type enum memcg_stat_item or node_stat_item.
- * Keep in sync with memcg_exact_page().
- */
-static unsigned long memcg_exact_page_state(struct mem_cgroup *memcg, int idx)
-{
-	long x = atomic_long_read(&memcg->vmstats[idx]);
-	int cpu;
-
-	for_each_online_cpu(cpu)
-		x += per_cpu_ptr(memcg->vmstats_percpu, cpu)->stat[idx];
-	if (x < 0)
-		x = 0;
-	return x;
-}
-
 /**
  * mem_cgroup_wb_stats - retrieve writeback related stats from its memcg
  * @wb: bdi_writeback in question
@@ -4606,11 +4815,12 @@ void mem_cgroup_wb_stats(struct bdi_writeback *wb, unsigned long *pfilepages,
 	struct mem_cgroup *memcg = mem_cgroup_from_css(wb->memcg_css);
 	struct mem_cgroup *parent;
 
-	*pdirty = memcg_exact_page_state(memcg, NR_FILE_DIRTY);
+	mem_cgroup_flush_stats();
 
-	*pwriteback = memcg_exact_page_state(memcg, NR_WRITEBACK);
-	*pfilepages = memcg_exact_page_state(memcg, NR_INACTIVE_FILE) +
-			memcg_exact_page_state(memcg, NR_ACTIVE_FILE);
+	*pdirty = memcg_page_state(memcg, NR_FILE_DIRTY);
+	*pwriteback = memcg_page_state(memcg, NR_WRITEBACK);
+	*pfilepages = memcg_page_state(memcg, NR_INACTIVE_FILE) +
+			memcg_page_state(memcg, NR_ACTIVE_FILE);
 	*pheadroom = PAGE_COUNTER_MAX;
 
 	while ((parent = parent_mem_cgroup(memcg))) {
@@ -5244,7 +5454,6 @@ static void __mem_cgroup_free(struct mem_cgroup *memcg)
 	for_each_node(node)
 		free_mem_cgroup_per_node_info(memcg, node);
 	free_percpu(memcg->vmstats_percpu);
-	free_percpu(memcg->vmstats_local);
 	kfree(memcg);
 }
 
@@ -5252,11 +5461,11 @@ static void mem_cgroup_free(struct mem_cgroup *memcg)
 {
 	memcg_wb_domain_exit(memcg);
 	/*
-	 * Flush percpu vmstats and vmevents to guarantee the value correctness
-	 * on parent's and all ancestor levels.
+	 * Flush percpu lruvec stats to guarantee the value correctness
+	 * on parent's and all ancestor levels. The memcg-level stats and
+	 * events were propagated by the rstat flush on css release.
 	 */
-	memcg_flush_percpu_vmstats(memcg);
-	memcg_flush_percpu_vmevents(memcg);
+	memcg_flush_lruvec_page_state(memcg);
 	__mem_cgroup_free(memcg);
 }
 
@@ -5283,11 +5492,6 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 		goto fail;
 	}
 
-	memcg->vmstats_local = alloc_percpu_gfp(struct memcg_vmstats_percpu,
-						GFP_KERNEL_ACCOUNT);
-	if (!memcg->vmstats_local)
-		goto fail;
-
 	memcg->vmstats_percpu = alloc_percpu_gfp(struct memcg_vmstats_percpu,
 						 GFP_KERNEL_ACCOUNT);
 	if (!memcg->vmstats_percpu)
@@ -5347,6 +5551,9 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	page_counter_set_high(&memcg->memory, PAGE_COUNTER_MAX);
 	memcg->soft_limit = PAGE_COUNTER_MAX;
 	page_counter_set_high(&memcg->swap, PAGE_COUNTER_MAX);
+#ifdef CONFIG_ZSWAP
+	memcg->zswap_max = PAGE_COUNTER_MAX;
+#endif
 	if (parent) {
 		memcg->swappiness = mem_cgroup_swappiness(parent);
 		memcg->oom_kill_disable = parent->oom_kill_disable;
@@ -5413,6 +5620,10 @@ static int mem_cgroup_css_online(struct cgroup_subsys_state *css)
 	/* Online state pins memcg ID, memcg ID pins CSS */
 	refcount_set(&memcg->id.ref, 1);
 	css_get(css);
+
+	if (unlikely(mem_cgroup_is_root(memcg)))
+		queue_delayed_work(system_unbound_wq, &stats_flush_dwork,
+				   msecs_to_jiffies(stats_flush_interval_ms));
 	return 0;
 }
 
@@ -5503,6 +5714,64 @@ static void mem_cgroup_css_reset(struct cgroup_subsys_state *css)
 	memcg_wb_domain_size_changed(memcg);
 }
 
+static void mem_cgroup_css_rstat_flush(struct cgroup_subsys_state *css, int cpu)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+	struct mem_cgroup *parent = parent_mem_cgroup(memcg);
+	struct memcg_vmstats_percpu *statc;
+	long delta, v;
+	int i;
+
+	statc = per_cpu_ptr(memcg->vmstats_percpu, cpu);
+
+	for (i = 0; i < MEMCG_NR_STAT; i++) {
+		/*
+		 * Collect the aggregated propagation counts of groups
+		 * below us. We're in a per-cpu loop here and this is
+		 * a global counter, so the first cycle will get them.
+		 */
+		delta = memcg->vmstats.state_pending[i];
+		if (delta)
+			memcg->vmstats.state_pending[i] = 0;
+
+		/* Add CPU changes on this level since the last flush */
+		v = READ_ONCE(statc->state[i]);
+		if (v != statc->state_prev[i]) {
+			delta += v - statc->state_prev[i];
+			statc->state_prev[i] = v;
+		}
+
+		if (!delta)
+			continue;
+
+		/* Aggregate counts on this level and propagate upwards */
+		WRITE_ONCE(memcg->vmstats.state[i],
+			   memcg->vmstats.state[i] + delta);
+		if (parent)
+			parent->vmstats.state_pending[i] += delta;
+	}
+
+	for (i = 0; i < NR_VM_EVENT_ITEMS; i++) {
+		delta = memcg->vmstats.events_pending[i];
+		if (delta)
+			memcg->vmstats.events_pending[i] = 0;
+
+		v = READ_ONCE(statc->events[i]);
+		if (v != statc->events_prev[i]) {
+			delta += v - statc->events_prev[i];
+			statc->events_prev[i] = v;
+		}
+
+		if (!delta)
+			continue;
+
+		WRITE_ONCE(memcg->vmstats.events[i],
+			   memcg->vmstats.events[i] + delta);
+		if (parent)
+			parent->vmstats.events_pending[i] += delta;
+	}
+}
+
 #ifdef CONFIG_MMU
 /* Handlers for move charge at task migration. */
 static int mem_cgroup_do_precharge(unsigned long count)
@@ -6499,6 +6768,92 @@ static ssize_t memory_oom_group_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+enum {
+	MEMORY_RECLAIM_SWAPPINESS = 0,
+	MEMORY_RECLAIM_NODES,
+	MEMORY_RECLAIM_NULL,
+};
+
+static const match_table_t memory_reclaim_tokens = {
+	{ MEMORY_RECLAIM_SWAPPINESS, "swappiness=%d" },
+	{ MEMORY_RECLAIM_NODES, "nodes=%s" },
+	{ MEMORY_RECLAIM_NULL, NULL },
+};
+
+static ssize_t memory_reclaim(struct kernfs_open_file *of, char *buf,
+			      size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int nr_retries = MAX_RECLAIM_RETRIES;
+	unsigned long nr_to_reclaim, nr_reclaimed = 0;
+	nodemask_t nodemask, *nodes = NULL;
+	int swappiness, *swappiness_p = NULL;
+	substring_t args[MAX_OPT_ARGS];
+	char *opt, *size;
+	int err;
+
+	buf = strstrip(buf);
+	size = strsep(&buf, " ");
+	err = page_counter_memparse(size, "", &nr_to_reclaim);
+	if (err)
+		return err;
+
+	while ((opt = strsep(&buf, " ")) != NULL) {
+		if (!*opt)
+			continue;
+
+		switch (match_token(opt, memory_reclaim_tokens, args)) {
+		case MEMORY_RECLAIM_SWAPPINESS:
+			if (match_int(&args[0], &swappiness))
+				return -EINVAL;
+			if (swappiness < 0 || swappiness > 200)
+				return -EINVAL;
+			swappiness_p = &swappiness;
+			break;
+		case MEMORY_RECLAIM_NODES:
+			opt = match_strdup(&args[0]);
+			if (!opt)
+				return -ENOMEM;
+			err = nodelist_parse(opt, nodemask);
+			kfree(opt);
+			if (err)
+				return err;
+			if (!nodes_intersects(nodemask, node_states[N_MEMORY]))
+				return -EINVAL;
+			nodes = &nodemask;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	while (nr_reclaimed < nr_to_reclaim) {
+		unsigned long reclaimed;
+
+		if (signal_pending(current))
+			return -EINTR;
+
+		/*
+		 * This is the final attempt, drain percpu lru caches in the
+		 * hope of introducing more evictable pages for
+		 * try_to_free_mem_cgroup_pages_nodemask().
+		 */
+		if (!nr_retries)
+			lru_add_drain_all();
+
+		reclaimed = try_to_free_mem_cgroup_pages_nodemask(memcg,
+					nr_to_reclaim - nr_reclaimed,
+					GFP_KERNEL, true, swappiness_p, nodes);
+
+		if (!reclaimed && !nr_retries--)
+			return -EAGAIN;
+
+		nr_reclaimed += reclaimed;
+	}
+
+	return nbytes;
+}
+
 static struct cftype memory_files[] = {
 	{
 		.name = "current",
@@ -6557,6 +6912,11 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_oom_group_show,
 		.write = memory_oom_group_write,
 	},
+	{
+		.name = "reclaim",
+		.flags = CFTYPE_NS_DELEGATABLE,
+		.write = memory_reclaim,
+	},
 	{ }	/* terminate */
 };
 
@@ -6567,6 +6927,7 @@ struct cgroup_subsys memory_cgrp_subsys = {
 	.css_released = mem_cgroup_css_released,
 	.css_free = mem_cgroup_css_free,
 	.css_reset = mem_cgroup_css_reset,
+	.css_rstat_flush = mem_cgroup_css_rstat_flush,
 	.can_attach = mem_cgroup_can_attach,
 	.cancel_attach = mem_cgroup_cancel_attach,
 	.post_attach = mem_cgroup_move_task,
@@ -7517,3 +7878,154 @@ static int __init mem_cgroup_swap_init(void)
 core_initcall(mem_cgroup_swap_init);
 
 #endif /* CONFIG_MEMCG_SWAP */
+
+#if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
+/**
+ * obj_cgroup_may_zswap - check if this cgroup can zswap
+ * @objcg: the object cgroup
+ *
+ * Check if the hierarchical zswap limit has been reached.
+ *
+ * This doesn't check for specific headroom, and it is not atomic
+ * either. But with zswap, the size of the allocation is only known
+ * once compression has occurred, and this optimistic pre-check avoids
+ * spending cycles on compression when there is already no room left
+ * or zswap is disabled altogether somewhere in the hierarchy.
+ */
+bool obj_cgroup_may_zswap(struct obj_cgroup *objcg)
+{
+	struct mem_cgroup *memcg;
+	bool ret = true;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return true;
+
+	mem_cgroup_flush_stats();
+
+	rcu_read_lock();
+	for (memcg = obj_cgroup_memcg(objcg); memcg != root_mem_cgroup;
+	     memcg = parent_mem_cgroup(memcg)) {
+		unsigned long max = READ_ONCE(memcg->zswap_max);
+
+		if (max == PAGE_COUNTER_MAX)
+			continue;
+		if (max == 0 ||
+		    memcg_page_state(memcg, MEMCG_ZSWAP_B) / PAGE_SIZE >= max) {
+			ret = false;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+/**
+ * obj_cgroup_charge_zswap - charge compression backend memory
+ * @objcg: the object cgroup
+ * @size: size of compressed object
+ *
+ * This forces the charge after obj_cgroup_may_zswap() allowed
+ * compression and storage in zswap for this cgroup to go ahead.
+ */
+void obj_cgroup_charge_zswap(struct obj_cgroup *objcg, size_t size)
+{
+	struct mem_cgroup *memcg;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return;
+
+	/*
+	 * Not every swapout runs under PF_MEMALLOC (MADV_PAGEOUT does not),
+	 * so force the charge rather than reclaim from here: the compressed
+	 * copy is smaller than the page it lets us free, and the entry is
+	 * uncharged by obj_cgroup_uncharge_zswap() whatever happens.
+	 */
+	obj_cgroup_charge(objcg, GFP_NOWAIT | __GFP_NOFAIL, size);
+
+	rcu_read_lock();
+	memcg = obj_cgroup_memcg(objcg);
+	mod_memcg_state(memcg, MEMCG_ZSWAP_B, size);
+	mod_memcg_state(memcg, MEMCG_ZSWAPPED, 1);
+	rcu_read_unlock();
+}
+
+/**
+ * obj_cgroup_uncharge_zswap - uncharge compression backend memory
+ * @objcg: the object cgroup
+ * @size: size of compressed object
+ *
+ * Uncharges zswap memory on page in.
+ */
+void obj_cgroup_uncharge_zswap(struct obj_cgroup *objcg, size_t size)
+{
+	struct mem_cgroup *memcg;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return;
+
+	obj_cgroup_uncharge(objcg, size);
+
+	rcu_read_lock();
+	memcg = obj_cgroup_memcg(objcg);
+	mod_memcg_state(memcg, MEMCG_ZSWAP_B, -size);
+	mod_memcg_state(memcg, MEMCG_ZSWAPPED, -1);
+	rcu_read_unlock();
+}
+
+static u64 zswap_current_read(struct cgroup_subsys_state *css,
+			      struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	mem_cgroup_flush_stats();
+	return memcg_page_state(memcg, MEMCG_ZSWAP_B);
+}
+
+static int zswap_max_show(struct seq_file *m, void *v)
+{
+	return seq_puts_memcg_tunable(m,
+		READ_ONCE(mem_cgroup_from_seq(m)->zswap_max));
+}
+
+static ssize_t zswap_max_write(struct kernfs_open_file *of,
+			       char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned long max;
+	int err;
+
+	buf = strstrip(buf);
+	err = page_counter_memparse(buf, "max", &max);
+	if (err)
+		return err;
+
+	xchg(&memcg->zswap_max, max);
+
+	return nbytes;
+}
+
+static struct cftype zswap_files[] = {
+	{
+		.name = "zswap.current",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = zswap_current_read,
+	},
+	{
+		.name = "zswap.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = zswap_max_show,
+		.write = zswap_max_write,
+	},
+	{ }	/* terminate */
+};
+
+static int __init mem_cgroup_zswap_init(void)
+{
+	if (!mem_cgroup_disabled())
+		WARN_ON(cgroup_add_dfl_cftypes(&memory_cgrp_subsys, zswap_files));
+
+	return 0;
+}
+subsys_initcall(mem_cgroup_zswap_init);
+#endif /* CONFIG_MEMCG_KMEM && CONFIG_ZSWAP */
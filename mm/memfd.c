@@ -150,7 +150,8 @@ static unsigned int *memfd_file_seals_ptr(struct file *file)
 		     F_SEAL_SHRINK | \
 		     F_SEAL_GROW | \
 		     F_SEAL_WRITE | \
-		     F_SEAL_FUTURE_WRITE)
+		     F_SEAL_FUTURE_WRITE | \
+		     F_SEAL_NOSPLIT)
 
 static int memfd_add_seals(struct file *file, unsigned int seals)
 {
@@ -175,6 +176,9 @@ static int memfd_add_seals(struct file *file, unsigned int seals)
 	 *   SEAL_SHRINK: Prevent the file from shrinking
 	 *   SEAL_GROW: Prevent the file from growing
 	 *   SEAL_WRITE: Prevent write access to the file
+	 *   SEAL_NOSPLIT: Prevent the huge pages of the file from being split,
+	 *                 which also locks them in memory; needs SEAL_GROW and
+	 *                 SEAL_SHRINK, and is charged against RLIMIT_MEMLOCK
 	 *
 	 * As we don't require any trust relationship between two parties, we
 	 * must prevent seals from being removed. Therefore, sealing a file
@@ -219,6 +223,16 @@ static int memfd_add_seals(struct file *file, unsigned int seals)
 		}
 	}
 
+	if ((seals & F_SEAL_NOSPLIT) && !(*file_seals & F_SEAL_NOSPLIT)) {
+		error = shmem_seal_nosplit(file, *file_seals | seals);
+		if (error) {
+			if ((seals & F_SEAL_WRITE) &&
+			    !(*file_seals & F_SEAL_WRITE))
+				mapping_allow_writable(file->f_mapping);
+			goto unlock;
+		}
+	}
+
 	*file_seals |= seals;
 	error = 0;
 
@@ -261,7 +275,8 @@ long memfd_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 #define MFD_NAME_PREFIX_LEN (sizeof(MFD_NAME_PREFIX) - 1)
 #define MFD_NAME_MAX_LEN (NAME_MAX - MFD_NAME_PREFIX_LEN)
 
-#define MFD_ALL_FLAGS (MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB)
+#define MFD_ALL_FLAGS (MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB | \
+		       MFD_HUGEPAGE)
 
 SYSCALL_DEFINE2(memfd_create,
 		const char __user *, uname,
@@ -281,6 +296,9 @@ SYSCALL_DEFINE2(memfd_create,
 		if (flags & ~(unsigned int)(MFD_ALL_FLAGS |
 				(MFD_HUGE_MASK << MFD_HUGE_SHIFT)))
 			return -EINVAL;
+		/* Either hugetlbfs or transparent huge pages */
+		if (flags & MFD_HUGEPAGE)
+			return -EINVAL;
 	}
 
 	/* length includes terminating zero */
@@ -328,6 +346,12 @@ SYSCALL_DEFINE2(memfd_create,
 	file->f_mode |= FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE;
 	file->f_flags |= O_LARGEFILE;
 
+	if (flags & MFD_HUGEPAGE) {
+		error = shmem_file_set_hugepage(file);
+		if (error)
+			goto err_file;
+	}
+
 	if (flags & MFD_ALLOW_SEALING) {
 		file_seals = memfd_file_seals_ptr(file);
 		*file_seals &= ~F_SEAL_SEAL;
@@ -337,6 +361,8 @@ SYSCALL_DEFINE2(memfd_create,
 	kfree(name);
 	return fd;
 
+err_file:
+	fput(file);
 err_fd:
 	put_unused_fd(fd);
 err_name:
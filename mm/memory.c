@@ -4208,7 +4208,8 @@ static vm_fault_t do_read_fault(struct vm_fault *vmf)
 	 */
 	// map_pages ⽤于提前预先映射⽂件⻚相邻的若⼲⽂件⻚到相关 pte 中，从⽽减少缺⻚次数
 	// fault_around_bytes 控制预先映射的的字节数默认初始值为 65536（16个物理内存⻚）
-	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1) {
+	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1 &&
+	    !userfaultfd_minor(vmf->vma)) {
 		// 这⾥会尝试使⽤ map_pages 将缺⻚地址 address 附近的⽂件⻚预读进 page cache
 		// 然后填充相关的 pte，⽬的是减少缺⻚次数
 		ret = do_fault_around(vmf);
@@ -2170,7 +2170,7 @@ static struct page *alloc_page_interleave(gfp_t gfp, unsigned order,
  *	NULL when no page can be allocated.
  */
 struct page *
-alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
+alloc_pages_vma_noprof(gfp_t gfp, int order, struct vm_area_struct *vma,
 		unsigned long addr, int node, bool hugepage)
 {
 	struct mempolicy *pol;
@@ -2212,7 +2212,7 @@ alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
 			 * First, try to allocate THP only on local node, but
 			 * don't reclaim unnecessarily, just compact.
 			 */
-			page = __alloc_pages_node(hpage_node,
+			page = __alloc_pages_node_noprof(hpage_node,
 				gfp | __GFP_THISNODE | __GFP_NORETRY, order);
 
 			/*
@@ -2236,7 +2236,7 @@ alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
 out:
 	return page;
 }
-EXPORT_SYMBOL(alloc_pages_vma);
+EXPORT_SYMBOL(alloc_pages_vma_noprof);
 
 /**
  * 	alloc_pages_current - Allocate pages.
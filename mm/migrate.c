@@ -46,9 +46,11 @@
 #include <linux/mmu_notifier.h>
 #include <linux/page_idle.h>
 #include <linux/page_owner.h>
+#include <linux/pgalloc_tag.h>
 #include <linux/sched/mm.h>
 #include <linux/ptrace.h>
 #include <linux/oom.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 
@@ -576,6 +578,80 @@ static void __copy_gigantic_page(struct page *dst, struct page *src,
 	}
 }
 
+/*
+ * Number of CPUs a huge page copy is split across during migration.
+ * 1 copies in the migrating task only.
+ */
+unsigned int sysctl_migrate_copy_threads __read_mostly = 1;
+
+/* Don't bother handing out less than this many subpages to a worker */
+#define MIGRATE_COPY_CHUNK_MIN	64
+
+struct migrate_copy_work {
+	struct work_struct work;
+	struct page *dst;
+	struct page *src;
+	int nr_pages;
+};
+
+static void migrate_copy_workfn(struct work_struct *work)
+{
+	struct migrate_copy_work *mcw;
+	int i;
+
+	mcw = container_of(work, struct migrate_copy_work, work);
+	for (i = 0; i < mcw->nr_pages; i++) {
+		cond_resched();
+		copy_highpage(mcw->dst + i, mcw->src + i);
+	}
+}
+
+/*
+ * Copy a huge page of @nr_pages (at most MAX_ORDER_NR_PAGES, so the
+ * struct pages are contiguous) using unbound workers for all but the
+ * first chunk.  Returns false if the copy was not done and the caller
+ * must fall back to copying by itself.
+ */
+static bool copy_huge_page_parallel(struct page *dst, struct page *src,
+				    int nr_pages)
+{
+	struct migrate_copy_work *works;
+	int threads = READ_ONCE(sysctl_migrate_copy_threads);
+	int chunk, i;
+
+	/* Workers may need memory to start, don't wait for them in reclaim */
+	if (current->flags & PF_MEMALLOC)
+		return false;
+
+	threads = min(threads, nr_pages / MIGRATE_COPY_CHUNK_MIN);
+	if (threads <= 1)
+		return false;
+
+	works = kmalloc_array(threads, sizeof(*works),
+			      GFP_NOWAIT | __GFP_NOWARN);
+	if (!works)
+		return false;
+
+	chunk = DIV_ROUND_UP(nr_pages, threads);
+	for (i = 0; i < threads; i++) {
+		int start = i * chunk;
+
+		INIT_WORK(&works[i].work, migrate_copy_workfn);
+		works[i].dst = dst + start;
+		works[i].src = src + start;
+		works[i].nr_pages = min(chunk, nr_pages - start);
+		if (i)
+			queue_work(system_unbound_wq, &works[i].work);
+	}
+
+	migrate_copy_workfn(&works[0].work);
+	for (i = 1; i < threads; i++)
+		flush_work(&works[i].work);
+
+	kfree(works);
+	return true;
+}
+
 static void copy_huge_page(struct page *dst, struct page *src)
 {
 	int i;
@@ -596,6 +672,9 @@ static void copy_huge_page(struct page *dst, struct page *src)
 		nr_pages = thp_nr_pages(src);
 	}
 
+	if (copy_huge_page_parallel(dst, src, nr_pages))
+		return;
+
 	for (i = 0; i < nr_pages; i++) {
 		cond_resched();
 		copy_highpage(dst + i, src + i);
@@ -669,6 +748,7 @@ void migrate_page_states(struct page *newpage, struct page *page)
 		SetPageReadahead(newpage);
 
 	copy_page_owner(page, newpage);
+	pgalloc_tag_swap(newpage, page);
 
 	if (!PageHuge(page))
 		mem_cgroup_migrate(page, newpage);
@@ -1018,13 +1098,53 @@ out:
 	return rc;
 }
 
-static int __unmap_and_move(struct page *page, struct page *newpage,
-				int force, enum migrate_mode mode)
+/*
+ * __migrate_page_unmap() returns this when @page has been locked and
+ * unmapped but not yet moved; __migrate_page_move() finishes the job.
+ */
+#define MIGRATEPAGE_UNMAP		1
+
+/*
+ * Between the unmap and move steps, the anon_vma reference and whether
+ * the page was mapped are stashed in newpage->private.  anon_vma is at
+ * least word aligned, so the low bit is free.
+ */
+#define PAGE_WAS_MAPPED			0x1UL
+
+static void __migrate_page_record(struct page *newpage, int page_was_mapped,
+				  struct anon_vma *anon_vma)
+{
+	set_page_private(newpage, (unsigned long)anon_vma |
+			 (page_was_mapped ? PAGE_WAS_MAPPED : 0));
+}
+
+static void __migrate_page_extract(struct page *newpage, int *page_was_mapped,
+				   struct anon_vma **anon_vma)
+{
+	unsigned long private = page_private(newpage);
+
+	*anon_vma = (struct anon_vma *)(private & ~PAGE_WAS_MAPPED);
+	*page_was_mapped = !!(private & PAGE_WAS_MAPPED);
+	set_page_private(newpage, 0);
+}
+
+/*
+ * Lock @page and @newpage and replace the ptes of @page by migration
+ * entries.  With @batch the TLB flush for those ptes is left pending
+ * for try_to_unmap_flush().  With @nosleep, -EDEADLK is returned instead
+ * of sleeping on the page lock or on writeback, as the caller already
+ * holds the locks of other pages: writeback of @page may be waiting to
+ * lock one of them before it submits its I/O.
+ */
+static int __migrate_page_unmap(struct page *page, struct page *newpage,
+				int force, enum migrate_mode mode, bool batch,
+				bool nosleep)
 {
 	int rc = -EAGAIN;
 	int page_was_mapped = 0;
 	struct anon_vma *anon_vma = NULL;
 	bool is_lru = !__PageMovable(page);
+	enum ttu_flags ttu = TTU_MIGRATION | TTU_IGNORE_MLOCK;
 
 	if (!trylock_page(page)) {
 		if (!force || mode == MIGRATE_ASYNC)
@@ -1046,6 +1166,11 @@ static int __unmap_and_move(struct page *page, struct page *newpage,
 		if (current->flags & PF_MEMALLOC)
 			goto out;
 
+		if (nosleep) {
+			rc = -EDEADLK;
+			goto out;
+		}
+
 		lock_page(page);
 	}
 
@@ -1066,6 +1191,10 @@ static int __unmap_and_move(struct page *page, struct page *newpage,
 		}
 		if (!force)
 			goto out_unlock;
+		if (nosleep) {
+			rc = -EDEADLK;
+			goto out_unlock;
+		}
 		wait_on_page_writeback(page);
 	}
 
@@ -1124,16 +1253,14 @@ static int __unmap_and_move(struct page *page, struct page *newpage,
 		/* Establish migration ptes */
 		VM_BUG_ON_PAGE(PageAnon(page) && !PageKsm(page) && !anon_vma,
 				page);
-		try_to_unmap(page, TTU_MIGRATION|TTU_IGNORE_MLOCK);
+		if (batch)
+			ttu |= TTU_BATCH_FLUSH;
+		try_to_unmap(page, ttu);
 		page_was_mapped = 1;
 	}
 
-	if (!page_mapped(page))
-		rc = move_to_new_page(newpage, page, mode);
-
-	if (page_was_mapped)
-		remove_migration_ptes(page,
-			rc == MIGRATEPAGE_SUCCESS ? newpage : page, false);
+	__migrate_page_record(newpage, page_was_mapped, anon_vma);
+	return MIGRATEPAGE_UNMAP;
 
 out_unlock_both:
 	unlock_page(newpage);
@@ -1163,43 +1290,59 @@ out:
 }
 
 /*
- * Obtain the lock on page, remove all ptes and migrate the page
- * to the newly allocated page in newpage.
+ * Second half of the migration of an LRU page unmapped by
+ * __migrate_page_unmap(): copy it to @newpage if all ptes are gone,
+ * restore the ptes and drop the locks.  Any TLB flush deferred by the
+ * unmap must have been done by now.
  */
-static int unmap_and_move(new_page_t get_new_page,
-				   free_page_t put_new_page,
-				   unsigned long private, struct page *page,
-				   int force, enum migrate_mode mode,
-				   enum migrate_reason reason)
+static int __migrate_page_move(struct page *page, struct page *newpage,
+			       enum migrate_mode mode)
 {
-	int rc = MIGRATEPAGE_SUCCESS;
-	struct page *newpage = NULL;
+	int rc = -EAGAIN;
+	int page_was_mapped;
+	struct anon_vma *anon_vma;
 
-	if (!thp_migration_supported() && PageTransHuge(page))
-		return -ENOMEM;
+	__migrate_page_extract(newpage, &page_was_mapped, &anon_vma);
 
-	if (page_count(page) == 1) {
-		/* page was freed from under us. So we are done. */
-		ClearPageActive(page);
-		ClearPageUnevictable(page);
-		if (unlikely(__PageMovable(page))) {
-			lock_page(page);
-			if (!PageMovable(page))
-				__ClearPageIsolated(page);
-			unlock_page(page);
-		}
-		goto out;
-	}
+	if (!page_mapped(page))
+		rc = move_to_new_page(newpage, page, mode);
 
-	newpage = get_new_page(page, private);
-	if (!newpage)
-		return -ENOMEM;
+	if (page_was_mapped)
+		remove_migration_ptes(page,
+			rc == MIGRATEPAGE_SUCCESS ? newpage : page, false);
+
+	unlock_page(newpage);
+	/* Drop an anon_vma reference if we took one */
+	if (anon_vma)
+		put_anon_vma(anon_vma);
+	unlock_page(page);
 
-	rc = __unmap_and_move(page, newpage, force, mode);
 	if (rc == MIGRATEPAGE_SUCCESS)
-		set_page_owner_migrate_reason(newpage, reason);
+		putback_lru_page(newpage);
 
-out:
+	return rc;
+}
+
+static int __unmap_and_move(struct page *page, struct page *newpage,
+				int force, enum migrate_mode mode)
+{
+	int rc;
+
+	rc = __migrate_page_unmap(page, newpage, force, mode, false, false);
+	if (rc == MIGRATEPAGE_UNMAP)
+		rc = __migrate_page_move(page, newpage, mode);
+
+	return rc;
+}
+
+/*
+ * Release @page and @newpage according to the outcome @rc of their
+ * migration.
+ */
+static void migrate_page_finish(struct page *page, struct page *newpage,
+				int rc, enum migrate_reason reason,
+				free_page_t put_new_page, unsigned long private)
+{
 	if (rc != -EAGAIN) {
 		/*
 		 * A page that has been migrated has all references
@@ -1250,10 +1393,158 @@ put_new:
 		else
 			put_page(newpage);
 	}
+}
+
+/*
+ * Obtain the lock on page, remove all ptes and migrate the page
+ * to the newly allocated page in newpage.
+ */
+static int unmap_and_move(new_page_t get_new_page,
+				   free_page_t put_new_page,
+				   unsigned long private, struct page *page,
+				   int force, enum migrate_mode mode,
+				   enum migrate_reason reason)
+{
+	int rc = MIGRATEPAGE_SUCCESS;
+	struct page *newpage = NULL;
+
+	if (!thp_migration_supported() && PageTransHuge(page))
+		return -ENOMEM;
+
+	if (page_count(page) == 1) {
+		/* page was freed from under us. So we are done. */
+		ClearPageActive(page);
+		ClearPageUnevictable(page);
+		if (unlikely(__PageMovable(page))) {
+			lock_page(page);
+			if (!PageMovable(page))
+				__ClearPageIsolated(page);
+			unlock_page(page);
+		}
+		goto out;
+	}
+
+	newpage = get_new_page(page, private);
+	if (!newpage)
+		return -ENOMEM;
+
+	rc = __unmap_and_move(page, newpage, force, mode);
+	if (rc == MIGRATEPAGE_SUCCESS)
+		set_page_owner_migrate_reason(newpage, reason);
+
+out:
+	migrate_page_finish(page, newpage, rc, reason, put_new_page, private);
+
+	return rc;
+}
+
+/*
+ * Order-0 LRU pages are migrated in batches: every page of the batch is
+ * locked and unmapped with its TLB flush deferred, a single flush then
+ * covers the whole batch before the pages are copied and remapped.  This
+ * saves a shootdown per page when the pages are mapped on other CPUs.
+ */
+#define MIGRATE_BATCH_NR	64
+
+struct migrate_batch {
+	struct list_head src;		/* unmapped pages, locked */
+	struct list_head dst;		/* their new pages, in the same order */
+	struct list_head retry;		/* pages to try again in the next pass */
+	int nr;
+	int nr_succeeded;
+	int nr_failed;
+	int nr_retry;
+	free_page_t *put_new_page;
+	unsigned long private;
+	enum migrate_mode mode;
+	enum migrate_reason reason;
+};
+
+static bool migrate_page_batchable(struct page *page)
+{
+	return !PageCompound(page) && !__PageMovable(page) &&
+		page_count(page) != 1;
+}
+
+/*
+ * Allocate the new page for @page and unmap @page, adding both to
+ * @batch on success.  Returns MIGRATEPAGE_UNMAP if the page was added,
+ * -EDEADLK if the batch must be moved before @page can be locked, or
+ * the result of a migration attempt that ended early.
+ */
+static int migrate_page_batch_unmap(struct migrate_batch *batch,
+				    new_page_t get_new_page, struct page *page,
+				    int force)
+{
+	struct page *newpage;
+	int rc;
+
+	newpage = get_new_page(page, batch->private);
+	if (!newpage)
+		return -ENOMEM;
+
+	rc = __migrate_page_unmap(page, newpage, force, batch->mode, true,
+				  batch->nr != 0);
+	if (rc == MIGRATEPAGE_UNMAP) {
+		list_move_tail(&page->lru, &batch->src);
+		list_add_tail(&newpage->lru, &batch->dst);
+		batch->nr++;
+		return rc;
+	}
+
+	if (rc == -EDEADLK) {
+		if (batch->put_new_page)
+			batch->put_new_page(newpage, batch->private);
+		else
+			put_page(newpage);
+		return rc;
+	}
 
+	if (rc == MIGRATEPAGE_SUCCESS)
+		set_page_owner_migrate_reason(newpage, batch->reason);
+	migrate_page_finish(page, newpage, rc, batch->reason,
+			    batch->put_new_page, batch->private);
 	return rc;
 }
 
+/* Flush the TLBs once for the whole batch, then move its pages */
+static void migrate_page_batch_move(struct migrate_batch *batch)
+{
+	struct page *page, *page2, *newpage, *newpage2;
+	int rc;
+
+	if (!batch->nr)
+		return;
+
+	try_to_unmap_flush();
+
+	newpage = list_first_entry(&batch->dst, struct page, lru);
+	list_for_each_entry_safe(page, page2, &batch->src, lru) {
+		newpage2 = list_next_entry(newpage, lru);
+		list_del(&newpage->lru);
+		cond_resched();
+
+		rc = __migrate_page_move(page, newpage, batch->mode);
+		switch (rc) {
+		case MIGRATEPAGE_SUCCESS:
+			set_page_owner_migrate_reason(newpage, batch->reason);
+			batch->nr_succeeded++;
+			break;
+		case -EAGAIN:
+			list_move_tail(&page->lru, &batch->retry);
+			batch->nr_retry++;
+			break;
+		default:
+			batch->nr_failed++;
+			break;
+		}
+		migrate_page_finish(page, newpage, rc, batch->reason,
+				    batch->put_new_page, batch->private);
+		newpage = newpage2;
+	}
+	batch->nr = 0;
+}
+
 /*
  * Counterpart of unmap_and_move_page() for hugepage migration.
  *
@@ -1430,6 +1721,15 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 	struct page *page2;
 	int swapwrite = current->flags & PF_SWAPWRITE;
 	int rc, nr_subpages;
+	struct migrate_batch batch = {
+		.src = LIST_HEAD_INIT(batch.src),
+		.dst = LIST_HEAD_INIT(batch.dst),
+		.retry = LIST_HEAD_INIT(batch.retry),
+		.put_new_page = put_new_page,
+		.private = private,
+		.mode = mode,
+		.reason = reason,
+	};
 
 	if (!swapwrite)
 		current->flags |= PF_SWAPWRITE;
@@ -1449,14 +1749,33 @@ retry:
 			nr_subpages = thp_nr_pages(page);
 			cond_resched();
 
-			if (PageHuge(page))
-				rc = unmap_and_move_huge_page(get_new_page,
-						put_new_page, private, page,
-						pass > 2, mode, reason);
-			else
-				rc = unmap_and_move(get_new_page, put_new_page,
-						private, page, pass > 2, mode,
-						reason);
+			if (migrate_page_batchable(page)) {
+				rc = migrate_page_batch_unmap(&batch,
+						get_new_page, page, pass > 2);
+				if (rc == -EDEADLK) {
+					migrate_page_batch_move(&batch);
+					goto retry;
+				}
+				if (rc == MIGRATEPAGE_UNMAP) {
+					if (batch.nr >= MIGRATE_BATCH_NR)
+						migrate_page_batch_move(&batch);
+					continue;
+				}
+			} else {
+				/*
+				 * The page lock may be slept on below: don't
+				 * hold the locks of the batch meanwhile.
+				 */
+				migrate_page_batch_move(&batch);
+				if (PageHuge(page))
+					rc = unmap_and_move_huge_page(get_new_page,
+							put_new_page, private, page,
+							pass > 2, mode, reason);
+				else
+					rc = unmap_and_move(get_new_page,
+							put_new_page, private, page,
+							pass > 2, mode, reason);
+			}
 
 			switch(rc) {
 			case -ENOMEM:
@@ -1518,11 +1837,20 @@ retry:
 				break;
 			}
 		}
+		migrate_page_batch_move(&batch);
+		retry += batch.nr_retry;
+		batch.nr_retry = 0;
+		list_splice_tail_init(&batch.retry, from);
 	}
 	nr_failed += retry + thp_retry;
 	nr_thp_failed += thp_retry;
-	rc = nr_failed;
+	rc = nr_failed + batch.nr_failed;
 out:
+	/* Finish the batch when bailing out, leave -EAGAIN pages to the caller */
+	migrate_page_batch_move(&batch);
+	list_splice_tail_init(&batch.retry, from);
+	nr_succeeded += batch.nr_succeeded;
+	nr_failed += batch.nr_failed;
 	count_vm_events(PGMIGRATE_SUCCESS, nr_succeeded);
 	count_vm_events(PGMIGRATE_FAIL, nr_failed);
 	count_vm_events(THP_MIGRATION_SUCCESS, nr_thp_succeeded);
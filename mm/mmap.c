@@ -37,6 +37,7 @@
 #include <linux/perf_event.h>
 #include <linux/audit.h>
 #include <linux/khugepaged.h>
+#include <linux/ksm.h>
 #include <linux/uprobes.h>
 #include <linux/rbtree_augmented.h>
 #include <linux/notifier.h>
@@ -1924,7 +1925,14 @@ unmap_writable:
 			allow_write_access(file);
 	}
 	file = vma->vm_file;
+	/*
+	 * vma_merge() registers merged vmas with khugepaged, do the same for
+	 * new ones so that read-only file text becomes eligible for collapse
+	 * without waiting for a later madvise() or vma expansion.
+	 */
+	khugepaged_enter_vma_merge(vma, vm_flags);
 out:
+	ksm_add_vma(vma);
 	perf_event_mmap(vma);
 
 	vm_stat_account(mm, vm_flags, len >> PAGE_SHIFT);
@@ -3200,6 +3208,7 @@ static int do_brk_flags(unsigned long addr, unsigned long len, unsigned long fla
 	vma->vm_page_prot = vm_get_page_prot(flags);
 	vma_link(mm, vma, prev, rb_link, rb_parent);
 out:
+	ksm_add_vma(vma);
 	perf_event_mmap(vma);
 	mm->total_vm += len >> PAGE_SHIFT;
 	mm->data_vm += len >> PAGE_SHIFT;
@@ -30,12 +30,11 @@
 
 #include "internal.h"
 
-static pmd_t *get_old_pmd(struct mm_struct *mm, unsigned long addr)
+static pud_t *get_old_pud(struct mm_struct *mm, unsigned long addr)
 {
 	pgd_t *pgd;
 	p4d_t *p4d;
 	pud_t *pud;
-	pmd_t *pmd;
 
 	pgd = pgd_offset(mm, addr);
 	if (pgd_none_or_clear_bad(pgd))
@@ -46,6 +45,21 @@ static pmd_t *get_old_pmd(struct mm_struct *mm, unsigned long addr)
 		return NULL;
 
 	pud = pud_offset(p4d, addr);
+	if (pud_none(*pud))
+		return NULL;
+
+	return pud;
+}
+
+static pmd_t *get_old_pmd(struct mm_struct *mm, unsigned long addr)
+{
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pud = get_old_pud(mm, addr);
+	if (!pud)
+		return NULL;
+
 	if (pud_none_or_clear_bad(pud))
 		return NULL;
 
@@ -56,19 +70,27 @@ static pmd_t *get_old_pmd(struct mm_struct *mm, unsigned long addr)
 	return pmd;
 }
 
-static pmd_t *alloc_new_pmd(struct mm_struct *mm, struct vm_area_struct *vma,
+static pud_t *alloc_new_pud(struct mm_struct *mm, struct vm_area_struct *vma,
 			    unsigned long addr)
 {
 	pgd_t *pgd;
 	p4d_t *p4d;
-	pud_t *pud;
-	pmd_t *pmd;
 
 	pgd = pgd_offset(mm, addr);
 	p4d = p4d_alloc(mm, pgd, addr);
 	if (!p4d)
 		return NULL;
-	pud = pud_alloc(mm, p4d, addr);
+
+	return pud_alloc(mm, p4d, addr);
+}
+
+static pmd_t *alloc_new_pmd(struct mm_struct *mm, struct vm_area_struct *vma,
+			    unsigned long addr)
+{
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pud = alloc_new_pud(mm, vma, addr);
 	if (!pud)
 		return NULL;
 
@@ -112,10 +134,16 @@ static pte_t move_soft_dirty_pte(pte_t pte)
 	return pte;
 }
 
+/*
+ * With @need_flush, the caller holds the rmap locks across several moves
+ * and flushes the TLB for all of them: *@need_flush is set if the moved
+ * ptes may still be cached.
+ */
 static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
 		unsigned long old_addr, unsigned long old_end,
 		struct vm_area_struct *new_vma, pmd_t *new_pmd,
-		unsigned long new_addr, bool need_rmap_locks)
+		unsigned long new_addr, bool need_rmap_locks,
+		bool *need_flush)
 {
 	struct mm_struct *mm = vma->vm_mm;
 	pte_t *old_pte, *new_pte, pte;
@@ -181,8 +209,12 @@ static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
 	}
 
 	arch_leave_lazy_mmu_mode();
-	if (force_flush)
+	if (need_flush) {
+		*need_flush |= force_flush;
+	} else if (force_flush) {
 		flush_tlb_range(vma, old_end - len, old_end);
+		count_vm_event(MREMAP_TLB_FLUSH);
+	}
 	if (new_ptl != old_ptl)
 		spin_unlock(new_ptl);
 	pte_unmap(new_pte - 1);
@@ -192,8 +224,10 @@ static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
 }
 
 #ifdef CONFIG_HAVE_MOVE_PMD
+/* With @defer_flush, the caller holds the rmap locks and flushes the TLB */
 static bool move_normal_pmd(struct vm_area_struct *vma, unsigned long old_addr,
-		  unsigned long new_addr, pmd_t *old_pmd, pmd_t *new_pmd)
+		  unsigned long new_addr, pmd_t *old_pmd, pmd_t *new_pmd,
+		  bool defer_flush)
 {
 	spinlock_t *old_ptl, *new_ptl;
 	struct mm_struct *mm = vma->vm_mm;
@@ -242,23 +276,199 @@ static bool move_normal_pmd(struct vm_area_struct *vma, unsigned long old_addr,
 
 	/* Set the new pmd */
 	set_pmd_at(mm, new_addr, new_pmd, pmd);
-	flush_tlb_range(vma, old_addr, old_addr + PMD_SIZE);
+	if (!defer_flush) {
+		flush_tlb_range(vma, old_addr, old_addr + PMD_SIZE);
+		count_vm_event(MREMAP_TLB_FLUSH);
+	}
+	if (new_ptl != old_ptl)
+		spin_unlock(new_ptl);
+	spin_unlock(old_ptl);
+
+	count_vm_event(MREMAP_MOVE_PMD);
+	return true;
+}
+#endif
+
+#ifdef CONFIG_HAVE_MOVE_PUD
+static bool move_normal_pud(struct vm_area_struct *vma, unsigned long old_addr,
+		  unsigned long new_addr, pud_t *old_pud, pud_t *new_pud)
+{
+	spinlock_t *old_ptl, *new_ptl;
+	struct mm_struct *mm = vma->vm_mm;
+	pud_t pud;
+
+	/* Huge puds are left to the pmd level, which splits them */
+	if (pud_trans_huge(*old_pud) || pud_devmap(*old_pud))
+		return false;
+
+	/* The destination pud shouldn't be established, see move_normal_pmd() */
+	if (WARN_ON_ONCE(!pud_none(*new_pud)))
+		return false;
+
+	/*
+	 * We don't have to worry about the ordering of src and dst
+	 * ptlocks because exclusive mmap_lock prevents deadlock.
+	 */
+	old_ptl = pud_lock(vma->vm_mm, old_pud);
+	new_ptl = pud_lockptr(mm, new_pud);
+	if (new_ptl != old_ptl)
+		spin_lock_nested(new_ptl, SINGLE_DEPTH_NESTING);
+
+	/* Clear the pud */
+	pud = *old_pud;
+	pud_clear(old_pud);
+
+	VM_BUG_ON(!pud_none(*new_pud));
+
+	/* Set the new pud */
+	set_pud_at(mm, new_addr, new_pud, pud);
+	flush_tlb_range(vma, old_addr, old_addr + PUD_SIZE);
+	count_vm_event(MREMAP_TLB_FLUSH);
 	if (new_ptl != old_ptl)
 		spin_unlock(new_ptl);
 	spin_unlock(old_ptl);
 
+	count_vm_event(MREMAP_MOVE_PUD);
 	return true;
 }
 #endif
 
+enum pgt_entry {
+	NORMAL_PMD,
+	HPAGE_PMD,
+	NORMAL_PUD,
+};
+
+/*
+ * Returns an extent of the corresponding size for the pgt_entry specified if
+ * valid. Else returns a smaller extent bounded by the end of the source and
+ * destination pgt_entry.
+ */
+static unsigned long get_extent(enum pgt_entry entry, unsigned long old_addr,
+				unsigned long old_end, unsigned long new_addr)
+{
+	unsigned long next, extent, mask, size;
+
+	switch (entry) {
+	case HPAGE_PMD:
+	case NORMAL_PMD:
+		mask = PMD_MASK;
+		size = PMD_SIZE;
+		break;
+	case NORMAL_PUD:
+		mask = PUD_MASK;
+		size = PUD_SIZE;
+		break;
+	default:
+		BUILD_BUG();
+		break;
+	}
+
+	next = (old_addr + size) & mask;
+	/* even if next overflowed, extent below will be ok */
+	extent = next - old_addr;
+	if (extent > old_end - old_addr)
+		extent = old_end - old_addr;
+	next = (new_addr + size) & mask;
+	if (extent > next - new_addr)
+		extent = next - new_addr;
+	return extent;
+}
+
+/*
+ * Moves of whole pte tables and of individual ptes are done in batches
+ * of up to MREMAP_BATCH_EXTENTS pmds, with a single TLB flush of the old
+ * range per batch instead of one per pmd.  The page tables of the
+ * destination are allocated first, then all entries are moved with the
+ * rmap locks held until the flush: rmap walkers such as reclaim or
+ * truncation are the only ones that could unmap and free a page through
+ * its new mapping while the old translation is still cached, everybody
+ * else needs the mmap_lock.  Nothing may be allocated while the rmap
+ * locks are held, as reclaim could be waiting on them.
+ *
+ * Returns the number of bytes moved, 0 if the range starts with
+ * something the batch doesn't handle (huge or migrating pmds).
+ */
+#define MREMAP_BATCH_EXTENTS	64
+
+static unsigned long move_page_tables_batch(struct vm_area_struct *vma,
+		unsigned long old_addr, unsigned long old_end,
+		struct vm_area_struct *new_vma, unsigned long new_addr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr, end, extent;
+	pmd_t *old_pmd, *new_pmd;
+	bool need_flush = false;
+	int nr;
+
+	for (nr = 0, end = old_addr; nr < MREMAP_BATCH_EXTENTS && end < old_end;
+	     nr++, end += extent) {
+		unsigned long new = new_addr + (end - old_addr);
+
+		extent = get_extent(NORMAL_PMD, end, old_end, new);
+		old_pmd = get_old_pmd(mm, end);
+		if (!old_pmd)
+			continue;
+		if (is_swap_pmd(*old_pmd) || pmd_trans_huge(*old_pmd) ||
+		    pmd_devmap(*old_pmd))
+			break;
+		new_pmd = alloc_new_pmd(mm, vma, new);
+		if (!new_pmd)
+			break;
+		/* A pmd level move wants the destination pmd empty */
+		if (IS_ENABLED(CONFIG_HAVE_MOVE_PMD) && extent == PMD_SIZE)
+			continue;
+		if (pte_alloc(new_vma->vm_mm, new_pmd))
+			break;
+	}
+
+	if (end == old_addr)
+		return 0;
+
+	take_rmap_locks(vma);
+	for (addr = old_addr; addr < end; addr += extent) {
+		unsigned long new = new_addr + (addr - old_addr);
+		pud_t *new_pud;
+
+		extent = get_extent(NORMAL_PMD, addr, old_end, new);
+		old_pmd = get_old_pmd(mm, addr);
+		if (!old_pmd)
+			continue;
+		new_pud = get_old_pud(mm, new);
+		if (WARN_ON_ONCE(!new_pud))
+			break;
+		new_pmd = pmd_offset(new_pud, new);
+#ifdef CONFIG_HAVE_MOVE_PMD
+		if (extent == PMD_SIZE && pmd_none(*new_pmd) &&
+		    move_normal_pmd(vma, addr, new, old_pmd, new_pmd, true)) {
+			need_flush = true;
+			continue;
+		}
+#endif
+		if (WARN_ON_ONCE(pmd_none(*new_pmd)))
+			break;
+		move_ptes(vma, old_pmd, addr, addr + extent, new_vma, new_pmd,
+			  new, false, &need_flush);
+		count_vm_event(MREMAP_MOVE_PTE);
+	}
+	if (need_flush) {
+		flush_tlb_range(vma, old_addr, addr);
+		count_vm_event(MREMAP_TLB_FLUSH);
+	}
+	drop_rmap_locks(vma);
+
+	return addr - old_addr;
+}
+
 unsigned long move_page_tables(struct vm_area_struct *vma,
 		unsigned long old_addr, struct vm_area_struct *new_vma,
 		unsigned long new_addr, unsigned long len,
 		bool need_rmap_locks)
 {
-	unsigned long extent, next, old_end;
+	unsigned long extent, old_end;
 	struct mmu_notifier_range range;
 	pmd_t *old_pmd, *new_pmd;
+	bool batch;
 
 	old_end = old_addr + len;
 	flush_cache_range(vma, old_addr, old_end);
@@ -267,16 +477,47 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 				old_addr, old_end);
 	mmu_notifier_invalidate_range_start(&range);
 
+	/*
+	 * Batching allocates destination page tables ahead of the moves,
+	 * which doesn't work when execve() moves the stack down over itself.
+	 */
+	batch = new_addr + len <= old_addr || old_end <= new_addr;
+
 	for (; old_addr < old_end; old_addr += extent, new_addr += extent) {
 		cond_resched();
-		next = (old_addr + PMD_SIZE) & PMD_MASK;
-		/* even if next overflowed, extent below will be ok */
-		extent = next - old_addr;
-		if (extent > old_end - old_addr)
-			extent = old_end - old_addr;
-		next = (new_addr + PMD_SIZE) & PMD_MASK;
-		if (extent > next - new_addr)
-			extent = next - new_addr;
+#ifdef CONFIG_HAVE_MOVE_PUD
+		/*
+		 * If extent is PUD-sized try to speed up the move by moving at
+		 * the PUD level if possible.
+		 */
+		extent = get_extent(NORMAL_PUD, old_addr, old_end, new_addr);
+		if (extent == PUD_SIZE) {
+			pud_t *old_pud, *new_pud;
+			bool moved;
+
+			old_pud = get_old_pud(vma->vm_mm, old_addr);
+			if (!old_pud)
+				continue;
+			new_pud = alloc_new_pud(vma->vm_mm, vma, new_addr);
+			if (!new_pud)
+				break;
+			/* The whole pmd table moves: see move_page_tables_batch() */
+			take_rmap_locks(vma);
+			moved = move_normal_pud(vma, old_addr, new_addr,
+						old_pud, new_pud);
+			drop_rmap_locks(vma);
+			if (moved)
+				continue;
+		}
+#endif
+		if (batch) {
+			extent = move_page_tables_batch(vma, old_addr, old_end,
+							new_vma, new_addr);
+			if (extent)
+				continue;
+		}
+
+		extent = get_extent(NORMAL_PMD, old_addr, old_end, new_addr);
 		old_pmd = get_old_pmd(vma->vm_mm, old_addr);
 		if (!old_pmd)
 			continue;
@@ -293,8 +534,10 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 						      old_pmd, new_pmd);
 				if (need_rmap_locks)
 					drop_rmap_locks(vma);
-				if (moved)
+				if (moved) {
+					count_vm_event(MREMAP_MOVE_PMD);
 					continue;
+				}
 			}
 			split_huge_pmd(vma, old_pmd, old_addr);
 			if (pmd_trans_unstable(old_pmd))
@@ -310,7 +553,7 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 			if (need_rmap_locks)
 				take_rmap_locks(vma);
 			moved = move_normal_pmd(vma, old_addr, new_addr,
-						old_pmd, new_pmd);
+						old_pmd, new_pmd, false);
 			if (need_rmap_locks)
 				drop_rmap_locks(vma);
 			if (moved)
@@ -321,7 +564,8 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 		if (pte_alloc(new_vma->vm_mm, new_pmd))
 			break;
 		move_ptes(vma, old_pmd, old_addr, old_addr + extent, new_vma,
-			  new_pmd, new_addr, need_rmap_locks);
+			  new_pmd, new_addr, need_rmap_locks, NULL);
+		count_vm_event(MREMAP_MOVE_PTE);
 	}
 
 	mmu_notifier_invalidate_range_end(&range);
@@ -495,8 +739,8 @@ static struct vm_area_struct *vma_to_resize(unsigned long addr,
 		return ERR_PTR(-EINVAL);
 	}
 
-	if (flags & MREMAP_DONTUNMAP && (!vma_is_anonymous(vma) ||
-			vma->vm_flags & VM_SHARED))
+	if ((flags & MREMAP_DONTUNMAP) &&
+			(vma->vm_flags & (VM_DONTEXPAND | VM_PFNMAP)))
 		return ERR_PTR(-EINVAL);
 
 	if (is_vm_hugetlb_page(vma))
@@ -43,9 +43,10 @@
 #include "internal.h"
 
 /*
- * Sleep at most 200ms at a time in balance_dirty_pages().
+ * Sleep at most dirty_max_pause_ms (200ms by default) at a time in
+ * balance_dirty_pages().
  */
-#define MAX_PAUSE		max(HZ/5, 1)
+#define MAX_PAUSE		max(msecs_to_jiffies(READ_ONCE(dirty_max_pause_ms)), 1UL)
 
 /*
  * Try to keep balance_dirty_pages() call intervals higher than this many pages
@@ -108,6 +109,11 @@ EXPORT_SYMBOL_GPL(dirty_writeback_interval);
  */
 unsigned int dirty_expire_interval = 30 * 100; /* centiseconds */
 
+/*
+ * The longest a dirtier is put to sleep at once when it is throttled
+ */
+unsigned int dirty_max_pause_ms = 200;
+
 /*
  * Flag that makes the machine dump writes/reads and block dirtyings.
  */
@@ -1411,6 +1417,29 @@ static unsigned long dirty_poll_interval(unsigned long dirty,
 	return 1;
 }
 
+/* Account a balance_dirty_pages() sleep globally and to current's memcg */
+static void count_dirty_pause(long pause)
+{
+	unsigned int ms = jiffies_to_msecs(pause);
+	enum vm_event_item item;
+
+	if (ms <= 4)
+		item = DIRTY_PAUSE_4MS;
+	else if (ms <= 16)
+		item = DIRTY_PAUSE_16MS;
+	else if (ms <= 64)
+		item = DIRTY_PAUSE_64MS;
+	else
+		item = DIRTY_PAUSE_LONG;
+
+	count_vm_event(item);
+	count_vm_events(DIRTY_PAUSE_MS, ms);
+	if (current->mm) {
+		count_memcg_event_mm(current->mm, item);
+		count_memcg_events_mm(current->mm, DIRTY_PAUSE_MS, ms);
+	}
+}
+
 static unsigned long wb_max_pause(struct bdi_writeback *wb,
 				  unsigned long wb_dirty)
 {
@@ -1793,6 +1822,7 @@ pause:
 					  start_time);
 		__set_current_state(TASK_KILLABLE);
 		wb->dirty_sleep = now;
+		count_dirty_pause(pause);
 		io_schedule_timeout(pause);
 
 		current->dirty_paused_when = now + pause;
@@ -2432,7 +2462,7 @@ void account_page_dirtied(struct page *page, struct address_space *mapping)
 
 		__inc_lruvec_page_state(page, NR_FILE_DIRTY);
 		__inc_zone_page_state(page, NR_ZONE_WRITE_PENDING);
-		__inc_node_page_state(page, NR_DIRTIED);
+		__inc_lruvec_page_state(page, NR_DIRTIED);
 		inc_wb_stat(wb, WB_RECLAIMABLE);
 		inc_wb_stat(wb, WB_DIRTIED);
 		task_io_account_write(PAGE_SIZE);
@@ -2521,7 +2551,7 @@ void account_page_redirty(struct page *page)
 
 		wb = unlocked_inode_to_wb_begin(inode, &cookie);
 		current->nr_dirtied--;
-		dec_node_page_state(page, NR_DIRTIED);
+		dec_lruvec_page_state(page, NR_DIRTIED);
 		dec_wb_stat(wb, WB_DIRTIED);
 		unlocked_inode_to_wb_end(inode, &cookie);
 	}
@@ -2758,7 +2788,7 @@ int test_clear_page_writeback(struct page *page)
 	if (ret) {
 		dec_lruvec_state(lruvec, NR_WRITEBACK);
 		dec_zone_page_state(page, NR_ZONE_WRITE_PENDING);
-		inc_node_page_state(page, NR_WRITTEN);
+		inc_lruvec_state(lruvec, NR_WRITTEN);
 	}
 	__unlock_page_memcg(memcg);
 	return ret;
@@ -62,6 +62,7 @@
 #include <linux/sched/rt.h>
 #include <linux/sched/mm.h>
 #include <linux/page_owner.h>
+#include <linux/pgalloc_tag.h>
 #include <linux/kthread.h>
 #include <linux/memcontrol.h>
 #include <linux/ftrace.h>
@@ -70,6 +71,7 @@
 #include <linux/psi.h>
 #include <linux/padata.h>
 #include <linux/khugepaged.h>
+#include <linux/page_prezero.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -1236,6 +1238,7 @@ static __always_inline bool free_pages_prepare(struct page *page,
 		if (memcg_kmem_enabled() && PageKmemcg(page))
 			__memcg_kmem_uncharge_page(page, order);
 		reset_page_owner(page, order);
+		pgalloc_tag_sub(page, 1 << order);
 		return false;
 	}
 
@@ -1273,6 +1276,7 @@ static __always_inline bool free_pages_prepare(struct page *page,
 	page_cpupid_reset_last(page);
 	page->flags &= ~PAGE_FLAGS_CHECK_AT_PREP;
 	reset_page_owner(page, order);
+	pgalloc_tag_sub(page, 1 << order);
 
 	if (!PageHighMem(page)) {
 		debug_check_no_locks_freed(page_address(page),
@@ -2303,6 +2307,7 @@ inline void post_alloc_hook(struct page *page, unsigned int order,
 	kasan_alloc_pages(page, order);
 	kernel_poison_pages(page, 1 << order, 1);
 	set_page_owner(page, order, gfp_flags);
+	pgalloc_tag_add(page, 1 << order);
 }
 /**
  * \brief 初始化内存页page
@@ -3367,6 +3372,7 @@ void split_page(struct page *page, unsigned int order)
 	for (i = 1; i < (1 << order); i++)
 		set_page_refcounted(page + i);
 	split_page_owner(page, 1 << order);
+	pgalloc_tag_split(page, 1 << order);
 	split_page_memcg(page, 1 << order);
 }
 EXPORT_SYMBOL_GPL(split_page);
@@ -5237,6 +5243,14 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order, int preferred_nid,
 	// 避免内存碎⽚化的相关分配标识设置，可暂时忽略
 	alloc_flags |= alloc_flags_nofragment(ac.preferred_zoneref->zone, gfp_mask);
 
+	/* Zeroed user pages may have been cleared ahead of time */
+	if (unlikely(gfp_mask & __GFP_ZERO) && !order) {
+		page = prezero_alloc_pages(gfp_mask, order, preferred_nid,
+					   ac.nodemask);
+		if (page)
+			goto out;
+	}
+
 	/* First allocation attempt */
 	// 内存分配快速路径：第⼀次尝试从底层伙伴系统分配内存，注意此时是在 WMARK_LOW ⽔位线之上分配内存
 	page = get_page_from_freelist(alloc_mask, order, alloc_flags, &ac);
@@ -5287,25 +5301,25 @@ EXPORT_SYMBOL(__alloc_pages_nodemask);
  */
 // 分配页，功能与alloc_pages一致，不同的是这里返回的是物理内存页对应的虚拟内存页地址
 // gfp：get free page的缩写，
-unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order)
+unsigned long __get_free_pages_noprof(gfp_t gfp_mask, unsigned int order)
 {
 	struct page *page;
 	// 不能在⾼端内存中分配物理⻚，因为⽆法直接映射获取虚拟内存地址
 	// 如果要在高端内存中分配物理页，则后面需要调用kmap映射将page映射到内核虚拟地址空间
-	page = alloc_pages(gfp_mask & ~__GFP_HIGHMEM, order);
+	page = alloc_pages_noprof(gfp_mask & ~__GFP_HIGHMEM, order);
 	if (!page)
 		return 0;
 	// 将直接映射区中的物理内存⻚转换为虚拟内存地址
 	// 只适用于内核虚拟空间的直接映射区
 	return (unsigned long) page_address(page);
 }
-EXPORT_SYMBOL(__get_free_pages);
+EXPORT_SYMBOL(__get_free_pages_noprof);
 
-unsigned long get_zeroed_page(gfp_t gfp_mask)
+unsigned long get_zeroed_page_noprof(gfp_t gfp_mask)
 {
-	return __get_free_pages(gfp_mask | __GFP_ZERO, 0);
+	return __get_free_pages_noprof(gfp_mask | __GFP_ZERO, 0);
 }
-EXPORT_SYMBOL(get_zeroed_page);
+EXPORT_SYMBOL(get_zeroed_page_noprof);
 
 static inline void free_the_page(struct page *page, unsigned int order)
 {
@@ -5321,9 +5335,11 @@ void __free_pages(struct page *page, unsigned int order)
 {
 	if (put_page_testzero(page))
 		free_the_page(page, order);
-	else if (!PageHead(page))
+	else if (!PageHead(page)) {
+		pgalloc_tag_sub_pages(page, (1 << order) - 1);
 		while (order-- > 0)
 			free_the_page(page + (1 << order), order);
+	}
 }
 EXPORT_SYMBOL(__free_pages);
 // 释放内存，这个addr是一个虚拟地址
@@ -5482,7 +5498,7 @@ static void *make_alloc_exact(unsigned long addr, unsigned int order,
  *
  * Return: pointer to the allocated area or %NULL in case of error.
  */
-void *alloc_pages_exact(size_t size, gfp_t gfp_mask)
+void *alloc_pages_exact_noprof(size_t size, gfp_t gfp_mask)
 {
 	unsigned int order = get_order(size);
 	unsigned long addr;
@@ -5490,10 +5506,10 @@ void *alloc_pages_exact(size_t size, gfp_t gfp_mask)
 	if (WARN_ON_ONCE(gfp_mask & __GFP_COMP))
 		gfp_mask &= ~__GFP_COMP;
 
-	addr = __get_free_pages(gfp_mask, order);
+	addr = __get_free_pages_noprof(gfp_mask, order);
 	return make_alloc_exact(addr, order, size);
 }
-EXPORT_SYMBOL(alloc_pages_exact);
+EXPORT_SYMBOL(alloc_pages_exact_noprof);
 
 /**
  * alloc_pages_exact_nid - allocate an exact number of physically-contiguous
@@ -7199,6 +7215,7 @@ static void pgdat_init_split_queue(struct pglist_data *pgdat) {}
 static void pgdat_init_kcompactd(struct pglist_data *pgdat)
 {
 	init_waitqueue_head(&pgdat->kcompactd_wait);
+	pgdat->compaction_proactiveness = -1;
 }
 #else
 static void pgdat_init_kcompactd(struct pglist_data *pgdat) {}
@@ -0,0 +1,520 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pool of pre-zeroed pages.
+ *
+ * Clearing the page is a large part of the cost of an anonymous fault,
+ * and for a THP fault it dominates: 512 base pages have to be written
+ * before the PMD can be installed.  kprezerod moves that work out of the
+ * fault path: one thread per memory node allocates pages from its node,
+ * clears them at idle priority and keeps them on a per-node list.
+ * Movable user allocations that ask for __GFP_ZERO, and the THP
+ * anonymous fault path, take pages from the list instead of clearing
+ * freshly allocated memory.
+ *
+ * The pool is empty by default.  Its size is set per node through
+ * /sys/kernel/mm/prezero/, and a shrinker gives the pages back to the
+ * page allocator under memory pressure.
+ */
+
+#include <linux/mm.h>
+#include <linux/mempolicy.h>
+#include <linux/cpuset.h>
+#include <linux/huge_mm.h>
+#include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/freezer.h>
+#include <linux/shrinker.h>
+#include <linux/sched.h>
+#include <linux/sched/mm.h>
+#include <linux/nodemask.h>
+#include <linux/slab.h>
+#include <linux/vmstat.h>
+#include <linux/memory.h>
+#include <linux/overflow.h>
+#include <linux/page_prezero.h>
+
+#include <uapi/linux/sched/types.h>
+
+enum prezero_type {
+	PREZERO_BASE,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	PREZERO_HUGE,
+#endif
+	NR_PREZERO_TYPES
+};
+
+struct prezero_pool {
+	/* Taken with interrupts disabled: atomic allocations use the pool */
+	spinlock_t lock;
+	struct list_head pages[NR_PREZERO_TYPES];
+	unsigned long nr_pages[NR_PREZERO_TYPES];
+	/* Do not refill before this time, set on shrink or allocation failure */
+	unsigned long backoff_until;
+	int nid;
+	struct task_struct *thread;
+	wait_queue_head_t wait;
+};
+
+DEFINE_STATIC_KEY_FALSE(page_prezero_enabled);
+
+static struct prezero_pool *prezero_pools[MAX_NUMNODES];
+static DEFINE_MUTEX(prezero_mutex);
+
+/* Number of pages of each type to keep zeroed, per node */
+static unsigned long prezero_target[NR_PREZERO_TYPES] __read_mostly;
+
+#define PREZERO_BACKOFF		HZ
+
+static inline unsigned int prezero_order(enum prezero_type type)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (type == PREZERO_HUGE)
+		return HPAGE_PMD_ORDER;
+#endif
+	return 0;
+}
+
+static inline int prezero_type(unsigned int order)
+{
+	if (!order)
+		return PREZERO_BASE;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (order == HPAGE_PMD_ORDER)
+		return PREZERO_HUGE;
+#endif
+	return -1;
+}
+
+/*
+ * Pooled pages are off the LRU, so neither migration nor memory offline,
+ * CMA or alloc_contig_range() can move them: keep them out of ZONE_MOVABLE
+ * and of movable and CMA pageblocks.  They only become movable once they
+ * are handed out and mapped.
+ */
+static inline gfp_t prezero_gfp(enum prezero_type type)
+{
+	gfp_t gfp = GFP_HIGHUSER | __GFP_NORETRY | __GFP_NOWARN;
+
+	/* Never compact on behalf of the pool, take what is already free */
+	if (prezero_order(type))
+		gfp = GFP_TRANSHUGE_LIGHT & ~__GFP_MOVABLE;
+	return gfp | __GFP_THISNODE;
+}
+
+static bool prezero_need_fill(struct prezero_pool *pool)
+{
+	int type;
+
+	if (time_before(jiffies, READ_ONCE(pool->backoff_until)))
+		return false;
+
+	for (type = 0; type < NR_PREZERO_TYPES; type++)
+		if (READ_ONCE(pool->nr_pages[type]) < READ_ONCE(prezero_target[type]))
+			return true;
+	return false;
+}
+
+/* Refill once the pool has been drained to half of its target */
+static void prezero_wakeup(struct prezero_pool *pool, enum prezero_type type)
+{
+	if (READ_ONCE(pool->nr_pages[type]) * 2 < READ_ONCE(prezero_target[type]) &&
+	    wq_has_sleeper(&pool->wait))
+		wake_up_interruptible(&pool->wait);
+}
+
+struct page *__prezero_alloc_pages(gfp_t gfp_mask, unsigned int order,
+				   int nid, nodemask_t *nodemask)
+{
+	struct prezero_pool *pool;
+	unsigned long flags;
+	struct page *page;
+	int type;
+
+	type = prezero_type(order);
+	if (type < 0)
+		return NULL;
+	if (order && !(gfp_mask & __GFP_COMP))
+		return NULL;
+	/* Pool pages are movable user memory and are not kmem charged */
+	if ((gfp_mask & (__GFP_HIGHMEM | __GFP_MOVABLE)) !=
+	    (__GFP_HIGHMEM | __GFP_MOVABLE) || (gfp_mask & __GFP_ACCOUNT))
+		return NULL;
+
+	if (nid == NUMA_NO_NODE)
+		nid = numa_node_id();
+	if (nodemask && !node_isset(nid, *nodemask))
+		return NULL;
+	if (!cpuset_node_allowed(nid, gfp_mask))
+		return NULL;
+
+	pool = READ_ONCE(prezero_pools[nid]);
+	if (!pool || !READ_ONCE(pool->nr_pages[type]))
+		return NULL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	page = list_first_entry_or_null(&pool->pages[type], struct page, lru);
+	if (page) {
+		list_del(&page->lru);
+		pool->nr_pages[type]--;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (!page)
+		return NULL;
+
+	prezero_wakeup(pool, type);
+	count_vm_event(order ? PREZERO_ALLOC_HUGE : PREZERO_ALLOC);
+	return page;
+}
+
+/*
+ * Fault paths that allocate through the vma policy only use the pool of
+ * the local node, so fall back to the regular allocator whenever a
+ * mempolicy could direct the allocation elsewhere.
+ */
+struct page *prezero_alloc_vma(gfp_t gfp_mask, struct vm_area_struct *vma,
+			       unsigned int order)
+{
+	if (!static_branch_unlikely(&page_prezero_enabled))
+		return NULL;
+#ifdef CONFIG_NUMA
+	if (vma_policy(vma) || current->mempolicy)
+		return NULL;
+#endif
+	return __prezero_alloc_pages(gfp_mask, order, numa_node_id(), NULL);
+}
+
+static bool prezero_fill_one(struct prezero_pool *pool, enum prezero_type type)
+{
+	unsigned int order = prezero_order(type);
+	struct page *page;
+	int i;
+
+	page = alloc_pages_node(pool->nid, prezero_gfp(type), order);
+	if (!page)
+		return false;
+
+	for (i = 0; i < (1 << order); i++) {
+		clear_highpage(page + i);
+		cond_resched();
+	}
+
+	spin_lock_irq(&pool->lock);
+	list_add(&page->lru, &pool->pages[type]);
+	pool->nr_pages[type]++;
+	spin_unlock_irq(&pool->lock);
+
+	count_vm_events(PREZERO_FILL, 1 << order);
+	return true;
+}
+
+static void prezero_fill(struct prezero_pool *pool)
+{
+	int type;
+
+	for (type = 0; type < NR_PREZERO_TYPES; type++) {
+		while (READ_ONCE(pool->nr_pages[type]) <
+		       READ_ONCE(prezero_target[type])) {
+			if (kthread_should_stop() || freezing(current) ||
+			    time_before(jiffies, READ_ONCE(pool->backoff_until)))
+				return;
+			if (!prezero_fill_one(pool, type)) {
+				WRITE_ONCE(pool->backoff_until,
+					   jiffies + PREZERO_BACKOFF);
+				break;
+			}
+		}
+	}
+}
+
+/* Free up to @nr_to_free base pages from @pool, huge pages first */
+static unsigned long prezero_drain(struct prezero_pool *pool,
+				   unsigned long nr_to_free)
+{
+	unsigned long freed = 0;
+	struct page *page;
+	int type;
+
+	for (type = NR_PREZERO_TYPES - 1; type >= 0; type--) {
+		while (freed < nr_to_free) {
+			spin_lock_irq(&pool->lock);
+			page = list_first_entry_or_null(&pool->pages[type],
+							struct page, lru);
+			if (page) {
+				list_del(&page->lru);
+				pool->nr_pages[type]--;
+			}
+			spin_unlock_irq(&pool->lock);
+
+			if (!page)
+				break;
+			__free_pages(page, prezero_order(type));
+			freed += 1UL << prezero_order(type);
+		}
+	}
+
+	count_vm_events(PREZERO_DRAIN, freed);
+	return freed;
+}
+
+static int kprezerod(void *data)
+{
+	struct prezero_pool *pool = data;
+	struct sched_param param = { .sched_priority = 0 };
+
+	set_freezable();
+	/* Only burn otherwise idle cycles */
+	sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+
+	while (!kthread_should_stop()) {
+		prezero_fill(pool);
+		wait_event_freezable_timeout(pool->wait,
+					     kthread_should_stop() ||
+					     prezero_need_fill(pool),
+					     PREZERO_BACKOFF);
+	}
+
+	return 0;
+}
+
+static unsigned long prezero_shrink_count(struct shrinker *shrink,
+					  struct shrink_control *sc)
+{
+	struct prezero_pool *pool = prezero_pools[sc->nid];
+	unsigned long count = 0;
+	int type;
+
+	if (!pool)
+		return 0;
+
+	for (type = 0; type < NR_PREZERO_TYPES; type++)
+		count += READ_ONCE(pool->nr_pages[type]) << prezero_order(type);
+	return count;
+}
+
+static unsigned long prezero_shrink_scan(struct shrinker *shrink,
+					 struct shrink_control *sc)
+{
+	struct prezero_pool *pool = prezero_pools[sc->nid];
+	unsigned long freed;
+
+	if (!pool)
+		return SHRINK_STOP;
+
+	/* Do not fight reclaim by refilling right away */
+	WRITE_ONCE(pool->backoff_until, jiffies + PREZERO_BACKOFF);
+	freed = prezero_drain(pool, sc->nr_to_scan);
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker prezero_shrinker = {
+	.count_objects = prezero_shrink_count,
+	.scan_objects = prezero_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+	.flags = SHRINKER_NUMA_AWARE,
+};
+
+/* Called with prezero_mutex held after a target has been changed */
+static void prezero_update_targets(void)
+{
+	bool enable = false;
+	int type, nid;
+
+	for (type = 0; type < NR_PREZERO_TYPES; type++)
+		if (prezero_target[type])
+			enable = true;
+
+	if (enable)
+		static_branch_enable(&page_prezero_enabled);
+	else
+		static_branch_disable(&page_prezero_enabled);
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct prezero_pool *pool = prezero_pools[nid];
+		unsigned long excess = 0;
+
+		if (!pool)
+			continue;
+
+		for (type = 0; type < NR_PREZERO_TYPES; type++) {
+			unsigned long nr = READ_ONCE(pool->nr_pages[type]);
+
+			if (nr > prezero_target[type])
+				excess += (nr - prezero_target[type]) <<
+					  prezero_order(type);
+		}
+		if (excess)
+			prezero_drain(pool, enable ? excess : ULONG_MAX);
+
+		WRITE_ONCE(pool->backoff_until, jiffies);
+		wake_up_interruptible(&pool->wait);
+	}
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t prezero_target_show(enum prezero_type type, char *buf)
+{
+	return sprintf(buf, "%lu\n", READ_ONCE(prezero_target[type]));
+}
+
+static ssize_t prezero_target_store(enum prezero_type type, const char *buf,
+				    size_t count)
+{
+	unsigned long nr, pages;
+	int err;
+
+	err = kstrtoul(buf, 10, &nr);
+	if (err)
+		return -EINVAL;
+	/* The pools of all nodes together may hold at most half of memory */
+	if (check_shl_overflow(nr, prezero_order(type), &pages) ||
+	    check_mul_overflow(pages, (unsigned long)num_node_state(N_MEMORY),
+			       &pages) ||
+	    pages > totalram_pages() / 2)
+		return -EINVAL;
+
+	mutex_lock(&prezero_mutex);
+	WRITE_ONCE(prezero_target[type], nr);
+	prezero_update_targets();
+	mutex_unlock(&prezero_mutex);
+
+	return count;
+}
+
+static ssize_t prezero_pooled_show(enum prezero_type type, char *buf)
+{
+	unsigned long nr = 0;
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY)
+		if (prezero_pools[nid])
+			nr += READ_ONCE(prezero_pools[nid]->nr_pages[type]);
+	return sprintf(buf, "%lu\n", nr);
+}
+
+#define PREZERO_ATTR(_name, _type)					\
+static ssize_t _name##_target_show(struct kobject *kobj,		\
+				   struct kobj_attribute *attr,		\
+				   char *buf)				\
+{									\
+	return prezero_target_show(_type, buf);				\
+}									\
+static ssize_t _name##_target_store(struct kobject *kobj,		\
+				    struct kobj_attribute *attr,	\
+				    const char *buf, size_t count)	\
+{									\
+	return prezero_target_store(_type, buf, count);			\
+}									\
+static ssize_t _name##_pooled_show(struct kobject *kobj,		\
+				   struct kobj_attribute *attr,		\
+				   char *buf)				\
+{									\
+	return prezero_pooled_show(_type, buf);				\
+}									\
+static struct kobj_attribute _name##_target_attr =			\
+	__ATTR(_name##_target, 0644, _name##_target_show,		\
+	       _name##_target_store);					\
+static struct kobj_attribute _name##_pooled_attr =			\
+	__ATTR_RO(_name##_pooled)
+
+PREZERO_ATTR(pages, PREZERO_BASE);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+PREZERO_ATTR(hugepages, PREZERO_HUGE);
+#endif
+
+static struct attribute *prezero_attrs[] = {
+	&pages_target_attr.attr,
+	&pages_pooled_attr.attr,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	&hugepages_target_attr.attr,
+	&hugepages_pooled_attr.attr,
+#endif
+	NULL,
+};
+
+static const struct attribute_group prezero_attr_group = {
+	.attrs = prezero_attrs,
+	.name = "prezero",
+};
+#endif /* CONFIG_SYSFS */
+
+/*
+ * Pools are created when their node gets memory, and stay around when it
+ * goes away again: the allocation paths look them up without locking.
+ */
+static int prezero_pool_create(int nid)
+{
+	struct prezero_pool *pool;
+	int type;
+
+	if (prezero_pools[nid])
+		return 0;
+
+	pool = kzalloc_node(sizeof(*pool), GFP_KERNEL, nid);
+	if (!pool)
+		return -ENOMEM;
+
+	spin_lock_init(&pool->lock);
+	for (type = 0; type < NR_PREZERO_TYPES; type++)
+		INIT_LIST_HEAD(&pool->pages[type]);
+	init_waitqueue_head(&pool->wait);
+	pool->nid = nid;
+
+	pool->thread = kthread_create_on_node(kprezerod, pool, nid,
+					      "kprezerod%d", nid);
+	if (IS_ERR(pool->thread)) {
+		pr_err("Failed to start kprezerod on node %d\n", nid);
+		kfree(pool);
+		return -ENOMEM;
+	}
+	if (!cpumask_empty(cpumask_of_node(nid)))
+		set_cpus_allowed_ptr(pool->thread, cpumask_of_node(nid));
+	WRITE_ONCE(prezero_pools[nid], pool);
+	wake_up_process(pool->thread);
+	return 0;
+}
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+static int prezero_memory_callback(struct notifier_block *self,
+				   unsigned long action, void *arg)
+{
+	struct memory_notify *mn = arg;
+	int nid = mn->status_change_nid;
+
+	if (action != MEM_ONLINE || nid == NUMA_NO_NODE)
+		return NOTIFY_OK;
+
+	mutex_lock(&prezero_mutex);
+	prezero_pool_create(nid);
+	mutex_unlock(&prezero_mutex);
+	return NOTIFY_OK;
+}
+#endif
+
+static int __init prezero_init(void)
+{
+	int nid, err;
+
+	mutex_lock(&prezero_mutex);
+	for_each_node_state(nid, N_MEMORY)
+		prezero_pool_create(nid);
+	mutex_unlock(&prezero_mutex);
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+	hotplug_memory_notifier(prezero_memory_callback, 0);
+#endif
+
+	err = register_shrinker(&prezero_shrinker);
+	if (err)
+		return err;
+
+#ifdef CONFIG_SYSFS
+	err = sysfs_create_group(mm_kobj, &prezero_attr_group);
+	if (err)
+		pr_err("prezero: register sysfs failed\n");
+#endif
+	return 0;
+}
+subsys_initcall(prezero_init);
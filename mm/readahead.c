@@ -26,6 +26,8 @@
 
 #include "internal.h"
 
+#include <trace/events/filemap.h>
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -375,7 +377,179 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * Several sequential streams reading through the same fd, e.g. threads
+ * doing pread() on different parts of a file, would keep resetting each
+ * other's window.  So when a new stream takes over the readahead state,
+ * the old one is parked in ra->streams, and is switched back in once a
+ * read arrives at where its window expects the next readahead.
+ *
+ * Reads that are not sequential but come in chunks of the same size at a
+ * fixed distance, like the column chunks of a table scan, are detected as
+ * strided: the following chunks are read ahead, with a readahead marker
+ * on one of them to keep the pipeline going.
+ *
+ * ra->streams is allocated the first time a file needs it, which keeps
+ * struct file small for the common single sequential reader.
+ */
+
+static bool ra_expected_index(pgoff_t start, unsigned int size,
+			      unsigned int async_size, pgoff_t index)
+{
+	return index == start + size - async_size || index == start + size;
+}
+
+/*
+ * Get the stream state of @ra, allocating it if needed.  Only the
+ * readahead state embedded in a struct file gets one, as that is where
+ * it is freed, see file_free_rcu().
+ */
+static struct file_ra_streams *ra_get_streams(struct readahead_control *ractl,
+					      struct file_ra_state *ra)
+{
+	struct file_ra_streams *rs = READ_ONCE(ra->streams);
+
+	if (rs)
+		return rs;
+	if (!ractl->file || ra != &ractl->file->f_ra)
+		return NULL;
+
+	rs = kzalloc(sizeof(*rs), GFP_NOWAIT | __GFP_NOWARN);
+	if (!rs)
+		return NULL;
+	/* Racing readers of the same file */
+	if (cmpxchg(&ra->streams, NULL, rs)) {
+		kfree(rs);
+		rs = READ_ONCE(ra->streams);
+	}
+	return rs;
+}
+
+/*
+ * Park the current stream, a new one is taking over the readahead state.
+ */
+static void ra_park_stream(struct readahead_control *ractl,
+			   struct file_ra_state *ra)
+{
+	struct file_ra_streams *rs;
+
+	if (!ra->size)
+		return;
+	rs = ra_get_streams(ractl, ra);
+	if (!rs)
+		return;
+
+	memmove(&rs->streams[1], &rs->streams[0],
+		sizeof(rs->streams[0]) * (RA_NR_STREAMS - 1));
+	rs->streams[0].start = ra->start;
+	rs->streams[0].size = ra->size;
+	rs->streams[0].async_size = ra->async_size;
+}
+
+/*
+ * Look for a parked stream that expects readahead at @index, and switch
+ * it with the current stream.
+ */
+static bool ra_switch_stream(struct file_ra_state *ra, pgoff_t index)
+{
+	struct file_ra_streams *rs = READ_ONCE(ra->streams);
+	struct file_ra_stream stream;
+	int i;
+
+	if (!rs)
+		return false;
+
+	for (i = 0; i < RA_NR_STREAMS; i++) {
+		stream = rs->streams[i];
+		if (stream.size && ra_expected_index(stream.start, stream.size,
+						     stream.async_size, index))
+			break;
+	}
+	if (i == RA_NR_STREAMS)
+		return false;
+
+	memmove(&rs->streams[1], &rs->streams[0], sizeof(rs->streams[0]) * i);
+	rs->streams[0].start = ra->start;
+	rs->streams[0].size = ra->size;
+	rs->streams[0].async_size = ra->async_size;
+
+	ra->start = stream.start;
+	ra->size = stream.size;
+	ra->async_size = stream.async_size;
+	return true;
+}
+
+/*
+ * Read the strided chunks starting at @index, as many as fit in @max
+ * pages, and mark the middle one to trigger the next batch.
+ */
+static void stride_readahead(struct readahead_control *ractl,
+			     struct file_ra_streams *rs, pgoff_t index,
+			     unsigned long max)
+{
+	unsigned long size = rs->stride_size;
+	unsigned long nr = max(max / size, 2UL);
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		ractl->_index = index + i * rs->stride;
+		do_page_cache_ra(ractl, size, i == nr / 2 ? size : 0);
+	}
+	rs->stride_marker = index + (nr / 2) * rs->stride;
+	rs->stride_last = index + (nr - 1) * rs->stride;
+}
+
+/*
+ * Detect strided reads on a cache miss: once two strides in a row have
+ * the same length and chunk size, read ahead the next chunks too.
  */
+static bool try_stride_readahead(struct readahead_control *ractl,
+				 struct file_ra_state *ra,
+				 unsigned long req_size,
+				 unsigned long max)
+{
+	struct file_ra_streams *rs = ra_get_streams(ractl, ra);
+	pgoff_t index = readahead_index(ractl);
+	pgoff_t prev;
+
+	if (!rs)
+		return false;
+
+	prev = rs->stride_last;
+	rs->stride_last = index;
+	if (index <= prev || index - prev <= req_size ||
+	    index - prev > UINT_MAX || req_size > max / 2) {
+		rs->stride = 0;
+		rs->stride_count = 0;
+		return false;
+	}
+
+	if (index - prev != rs->stride || req_size != rs->stride_size) {
+		rs->stride = index - prev;
+		rs->stride_size = req_size;
+		rs->stride_count = 1;
+		return false;
+	}
+
+	if (++rs->stride_count < 2)
+		return false;
+
+	stride_readahead(ractl, rs, index, max);
+	return true;
+}
+
+/*
+ * Did the reader hit the marker stride_readahead() left on a chunk?
+ */
+static struct file_ra_streams *ra_stride_marker(struct file_ra_state *ra,
+						pgoff_t index)
+{
+	struct file_ra_streams *rs = READ_ONCE(ra->streams);
+
+	if (rs && rs->stride && index == rs->stride_marker)
+		return rs;
+	return NULL;
+}
 
 /*
  * Count contiguously cached pages from @index-1 to @index-@max,
@@ -398,7 +572,7 @@ static pgoff_t count_history_pages(struct address_space *mapping,
 /*
  * page cache context based read-ahead
  */
-static int try_context_readahead(struct address_space *mapping,
+static int try_context_readahead(struct readahead_control *ractl,
 				 struct file_ra_state *ra,
 				 pgoff_t index,
 				 unsigned long req_size,
@@ -406,7 +580,7 @@ static int try_context_readahead(struct address_space *mapping,
 {
 	pgoff_t size;
 
-	size = count_history_pages(mapping, index, max);
+	size = count_history_pages(ractl->mapping, index, max);
 
 	/*
 	 * not enough history pages:
@@ -422,6 +596,7 @@ static int try_context_readahead(struct address_space *mapping,
 	if (size >= index)
 		size *= 2;
 
+	ra_park_stream(ractl, ra);
 	ra->start = index;
 	ra->size = min(size + req_size, max);
 	ra->async_size = 1;
@@ -456,13 +631,18 @@ static void ondemand_readahead(struct readahead_control *ractl,
 		goto initial_readahead;
 
 	/*
-	 * It's the expected callback index, assume sequential access.
-	 * Ramp up sizes, and push forward the readahead window.
+	 * It's the expected callback index of the current or a parked
+	 * stream, assume sequential access.
+	 * Ramp up sizes, and push forward the readahead window.  Go straight
+	 * to the maximum window if the reader caught up with the last one.
 	 */
-	if ((index == (ra->start + ra->size - ra->async_size) ||
-	     index == (ra->start + ra->size))) {
+	if (ra_expected_index(ra->start, ra->size, ra->async_size, index) ||
+	    ra_switch_stream(ra, index)) {
 		ra->start += ra->size;
-		ra->size = get_next_ra_size(ra, max_pages);
+		if (ra->boost)
+			ra->size = max_pages;
+		else
+			ra->size = get_next_ra_size(ra, max_pages);
 		ra->async_size = ra->size;
 		goto readit;
 	}
@@ -474,8 +654,15 @@ static void ondemand_readahead(struct readahead_control *ractl,
 	 * readahead size. Ramp it up and use it as the new readahead size.
 	 */
 	if (hit_readahead_marker) {
+		struct file_ra_streams *rs = ra_stride_marker(ra, index);
 		pgoff_t start;
 
+		if (rs) {
+			stride_readahead(ractl, rs, rs->stride_last + rs->stride,
+					 max_pages);
+			return;
+		}
+
 		rcu_read_lock();
 		start = page_cache_next_miss(ractl->mapping, index + 1,
 				max_pages);
@@ -484,6 +671,7 @@ static void ondemand_readahead(struct readahead_control *ractl,
 		if (!start || start - index > max_pages)
 			return;
 
+		ra_park_stream(ractl, ra);
 		ra->start = start;
 		ra->size = start - index;	/* old async_size */
 		ra->size += req_size;
@@ -511,10 +699,13 @@ static void ondemand_readahead(struct readahead_control *ractl,
 	 * Query the page cache and look for the traces(cached history pages)
 	 * that a sequential stream would leave behind.
 	 */
-	if (try_context_readahead(ractl->mapping, ra, index, req_size,
+	if (try_context_readahead(ractl, ra, index, req_size,
 			max_pages))
 		goto readit;
 
+	if (try_stride_readahead(ractl, ra, req_size, max_pages))
+		return;
+
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
@@ -523,6 +714,7 @@ static void ondemand_readahead(struct readahead_control *ractl,
 	return;
 
 initial_readahead:
+	ra_park_stream(ractl, ra);
 	ra->start = index;
 	ra->size = get_init_ra_size(req_size, max_pages);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
@@ -554,6 +746,8 @@ void page_cache_sync_ra(struct readahead_control *ractl,
 {
 	bool do_forced_ra = ractl->file && (ractl->file->f_mode & FMODE_RANDOM);
 
+	trace_mm_filemap_readahead_miss(ractl, ra, req_count);
+
 	/*
 	 * Even if read-ahead is disabled, issue this request as read-ahead
 	 * as we'll need it to satisfy the requested range. The forced
@@ -594,6 +788,15 @@ void page_cache_async_ra(struct readahead_control *ractl,
 
 	ClearPageReadahead(page);
 
+	trace_mm_filemap_readahead_hit(ractl, ra, req_count);
+
+	/*
+	 * The reader caught up with the readahead I/O, ramping the window
+	 * up is too slow to cover the device latency at the rate the file
+	 * is read.  Skip to ra_pages until the readahead is ahead again.
+	 */
+	ra->boost = !PageUptodate(page);
+
 	/*
 	 * Defer asynchronous read-ahead on IO congestion.
 	 */
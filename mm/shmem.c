@@ -575,9 +575,10 @@ static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 			goto next;
 		}
 
-		/* Check if there's anything to gain */
+		/* Check if there's anything to gain, or if we may split at all */
 		if (round_up(inode->i_size, PAGE_SIZE) ==
-				round_up(inode->i_size, HPAGE_PMD_SIZE)) {
+				round_up(inode->i_size, HPAGE_PMD_SIZE) ||
+		    (info->seals & F_SEAL_NOSPLIT)) {
 			list_move(&info->shrinklist, &to_remove);
 			goto next;
 		}
@@ -696,6 +697,14 @@ static inline bool is_huge_enabled(struct shmem_sb_info *sbinfo)
 	return false;
 }
 
+/* memfd_create(MFD_HUGEPAGE) files get huge pages whatever their mount says */
+static inline bool shmem_inode_huge(struct inode *inode)
+{
+	return IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) &&
+	       shmem_huge != SHMEM_HUGE_DENY &&
+	       (SHMEM_I(inode)->flags & VM_HUGEPAGE);
+}
+
 /*
  * Like add_to_page_cache_locked, but error if expected item has gone.
  */
@@ -1109,7 +1118,7 @@ static int shmem_getattr(const struct path *path, struct kstat *stat,
 	}
 	generic_fillattr(inode, stat);
 
-	if (is_huge_enabled(sb_info))
+	if (is_huge_enabled(sb_info) || shmem_inode_huge(inode))
 		stat->blksize = HPAGE_PMD_SIZE;
 
 	return 0;
@@ -1189,6 +1198,10 @@ static void shmem_evict_inode(struct inode *inode)
 
 	if (inode->i_mapping->a_ops == &shmem_aops) {
 		shmem_unacct_size(info->flags, inode->i_size);
+		if (info->nosplit_user) {
+			user_shm_unlock(inode->i_size, info->nosplit_user);
+			info->nosplit_user = NULL;
+		}
 		inode->i_size = 0;
 		shmem_truncate_range(inode, 0, (loff_t)-1);
 		if (!list_empty(&info->shrinklist)) {
@@ -1855,6 +1868,16 @@ repeat:
 	charge_mm = vma ? vma->vm_mm : current->mm;
 
 	page = find_lock_entry(mapping, index);
+
+	if (page && vma && userfaultfd_minor(vma)) {
+		if (!xa_is_value(page)) {
+			unlock_page(page);
+			put_page(page);
+		}
+		*fault_type = handle_userfault(vmf, VM_UFFD_MINOR);
+		return 0;
+	}
+
 	if (xa_is_value(page)) {
 		error = shmem_swapin_page(inode, index, &page,
 					  sgp, gfp, vma, fault_type);
@@ -1897,7 +1920,7 @@ repeat:
 		goto alloc_nohuge;
 	if (shmem_huge == SHMEM_HUGE_DENY || sgp_huge == SGP_NOHUGE)
 		goto alloc_nohuge;
-	if (shmem_huge == SHMEM_HUGE_FORCE)
+	if (shmem_huge == SHMEM_HUGE_FORCE || shmem_inode_huge(inode))
 		goto alloc_huge;
 	switch (sbinfo->huge) {
 	case SHMEM_HUGE_NEVER:
@@ -2164,6 +2187,7 @@ unsigned long shmem_get_unmapped_area(struct file *file,
 	unsigned long inflated_len;
 	unsigned long inflated_addr;
 	unsigned long inflated_offset;
+	bool huge_file;
 
 	if (len > TASK_SIZE)
 		return -ENOMEM;
@@ -2190,12 +2214,14 @@ unsigned long shmem_get_unmapped_area(struct file *file,
 	 * Our priority is to support MAP_SHARED mapped hugely;
 	 * and support MAP_PRIVATE mapped hugely too, until it is COWed.
 	 * But if caller specified an address hint and we allocated area there
-	 * successfully, respect that as before.
+	 * successfully, respect that as before: except for the MFD_HUGEPAGE
+	 * memfds, which are promised huge alignment.
 	 */
-	if (uaddr == addr)
+	huge_file = file && shmem_inode_huge(file_inode(file));
+	if (uaddr == addr && !huge_file)
 		return addr;
 
-	if (shmem_huge != SHMEM_HUGE_FORCE) {
+	if (shmem_huge != SHMEM_HUGE_FORCE && !huge_file) {
 		struct super_block *sb;
 
 		if (file) {
@@ -2378,6 +2404,48 @@ bool shmem_mapping(struct address_space *mapping)
 	return mapping->a_ops == &shmem_aops;
 }
 
+/*
+ * Back @file with huge pages whatever the huge= option of its mount, and
+ * align its mappings on huge page boundaries: for memfd_create(MFD_HUGEPAGE).
+ */
+int shmem_file_set_hugepage(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+
+	if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) ||
+	    !has_transparent_hugepage() || shmem_huge == SHMEM_HUGE_DENY)
+		return -EINVAL;
+
+	SHMEM_I(inode)->flags |= VM_HUGEPAGE;
+	return 0;
+}
+
+/*
+ * F_SEAL_NOSPLIT pins the pages of @file in memory, so charge them against
+ * RLIMIT_MEMLOCK as SHM_LOCK does, and keep them off the evictable LRUs.
+ * @seals must include F_SEAL_GROW and F_SEAL_SHRINK: the charge is for
+ * i_size, which then cannot change until the inode is evicted.
+ */
+int shmem_seal_nosplit(struct file *file, unsigned int seals)
+{
+	struct inode *inode = file_inode(file);
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	struct user_struct *user = current_user();
+
+	if (!shmem_file(file))
+		return -EINVAL;
+	if ((seals & (F_SEAL_GROW | F_SEAL_SHRINK)) !=
+	    (F_SEAL_GROW | F_SEAL_SHRINK))
+		return -EINVAL;
+	if (!user_shm_lock(inode->i_size, user))
+		return -ENOMEM;
+
+	info->nosplit_user = user;
+	info->flags |= VM_LOCKED;
+	mapping_set_unevictable(file->f_mapping);
+	return 0;
+}
+
 static int shmem_mfill_atomic_pte(struct mm_struct *dst_mm,
 				  pmd_t *dst_pmd,
 				  struct vm_area_struct *dst_vma,
@@ -4121,6 +4189,8 @@ bool shmem_huge_enabled(struct vm_area_struct *vma)
 		return true;
 	if (shmem_huge == SHMEM_HUGE_DENY)
 		return false;
+	if (shmem_inode_huge(inode))
+		return true;
 	switch (sbinfo->huge) {
 		case SHMEM_HUGE_NEVER:
 			return false;
@@ -237,33 +237,54 @@ static inline bool kmem_cache_debug_flags(struct kmem_cache *s, slab_flags_t fla
 	return false;
 }
 
+#if defined(CONFIG_MEMCG_KMEM) || defined(CONFIG_MEM_ALLOC_PROFILING)
+/*
+ * Per object data of a slab page, in a vector indexed by obj_to_index().
+ * It is allocated the first time an object of the page is charged to a
+ * memcg or tagged by allocation profiling.
+ */
+struct slabobj_ext {
 #ifdef CONFIG_MEMCG_KMEM
-static inline struct obj_cgroup **page_obj_cgroups(struct page *page)
+	struct obj_cgroup *objcg;
+#endif
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+	struct alloc_tag *tag;
+#endif
+};
+
+static inline struct slabobj_ext *page_obj_exts(struct page *page)
 {
 	/*
-	 * page->mem_cgroup and page->obj_cgroups are sharing the same
+	 * page->mem_cgroup and page->obj_exts are sharing the same
 	 * space. To distinguish between them in case we don't know for sure
 	 * that the page is a slab page (e.g. page_cgroup_ino()), let's
-	 * always set the lowest bit of obj_cgroups.
+	 * always set the lowest bit of obj_exts.
 	 */
-	return (struct obj_cgroup **)
-		((unsigned long)page->obj_cgroups & ~0x1UL);
+	return (struct slabobj_ext *)((unsigned long)page->obj_exts & ~0x1UL);
 }
 
-static inline bool page_has_obj_cgroups(struct page *page)
+static inline bool page_has_obj_exts(struct page *page)
 {
-	return ((unsigned long)page->obj_cgroups & 0x1UL);
+	return ((unsigned long)page->obj_exts & 0x1UL);
 }
 
-int memcg_alloc_page_obj_cgroups(struct page *page, struct kmem_cache *s,
-				 gfp_t gfp);
+int alloc_page_obj_exts(struct page *page, struct kmem_cache *s, gfp_t gfp);
+
+static inline void free_page_obj_exts(struct page *page)
+{
+	if (!page_has_obj_exts(page))
+		return;
 
-static inline void memcg_free_page_obj_cgroups(struct page *page)
+	kfree(page_obj_exts(page));
+	page->obj_exts = NULL;
+}
+#else
+static inline void free_page_obj_exts(struct page *page)
 {
-	kfree(page_obj_cgroups(page));
-	page->obj_cgroups = NULL;
 }
+#endif
 
+#ifdef CONFIG_MEMCG_KMEM
 static inline size_t obj_full_size(struct kmem_cache *s)
 {
 	/*
@@ -301,19 +322,8 @@ static inline bool memcg_slab_pre_alloc_hook(struct kmem_cache *s,
 	return true;
 }
 
-static inline void mod_objcg_state(struct obj_cgroup *objcg,
-				   struct pglist_data *pgdat,
-				   int idx, int nr)
-{
-	struct mem_cgroup *memcg;
-	struct lruvec *lruvec;
-
-	rcu_read_lock();
-	memcg = obj_cgroup_memcg(objcg);
-	lruvec = mem_cgroup_lruvec(memcg, pgdat);
-	mod_memcg_lruvec_state(lruvec, idx, nr);
-	rcu_read_unlock();
-}
+void mod_objcg_state(struct obj_cgroup *objcg, struct pglist_data *pgdat,
+		     enum node_stat_item idx, int nr);
 
 static inline void memcg_slab_post_alloc_hook(struct kmem_cache *s,
 					      struct obj_cgroup *objcg,
@@ -331,15 +341,15 @@ static inline void memcg_slab_post_alloc_hook(struct kmem_cache *s,
 		if (likely(p[i])) {
 			page = virt_to_head_page(p[i]);
 
-			if (!page_has_obj_cgroups(page) &&
-			    memcg_alloc_page_obj_cgroups(page, s, flags)) {
+			if (!page_has_obj_exts(page) &&
+			    alloc_page_obj_exts(page, s, flags)) {
 				obj_cgroup_uncharge(objcg, obj_full_size(s));
 				continue;
 			}
 
 			off = obj_to_index(s, page, p[i]);
 			obj_cgroup_get(objcg);
-			page_obj_cgroups(page)[off] = objcg;
+			page_obj_exts(page)[off].objcg = objcg;
 			mod_objcg_state(objcg, page_pgdat(page),
 					cache_vmstat_idx(s), obj_full_size(s));
 		} else {
@@ -366,7 +376,7 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s_orig,
 			continue;
 
 		page = virt_to_head_page(p[i]);
-		if (!page_has_obj_cgroups(page))
+		if (!page_has_obj_exts(page))
 			continue;
 
 		if (!s_orig)
@@ -375,11 +385,11 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s_orig,
 			s = s_orig;
 
 		off = obj_to_index(s, page, p[i]);
-		objcg = page_obj_cgroups(page)[off];
+		objcg = page_obj_exts(page)[off].objcg;
 		if (!objcg)
 			continue;
 
-		page_obj_cgroups(page)[off] = NULL;
+		page_obj_exts(page)[off].objcg = NULL;
 		obj_cgroup_uncharge(objcg, obj_full_size(s));
 		mod_objcg_state(objcg, page_pgdat(page), cache_vmstat_idx(s),
 				-obj_full_size(s));
@@ -388,26 +398,11 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s_orig,
 }
 
 #else /* CONFIG_MEMCG_KMEM */
-static inline bool page_has_obj_cgroups(struct page *page)
-{
-	return false;
-}
-
 static inline struct mem_cgroup *memcg_from_slab_obj(void *ptr)
 {
 	return NULL;
 }
 
-static inline int memcg_alloc_page_obj_cgroups(struct page *page,
-					       struct kmem_cache *s, gfp_t gfp)
-{
-	return 0;
-}
-
-static inline void memcg_free_page_obj_cgroups(struct page *page)
-{
-}
-
 static inline bool memcg_slab_pre_alloc_hook(struct kmem_cache *s,
 					     struct obj_cgroup **objcgp,
 					     size_t objects, gfp_t flags)
@@ -428,6 +423,50 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s,
 }
 #endif /* CONFIG_MEMCG_KMEM */
 
+#ifdef CONFIG_MEM_ALLOC_PROFILING
+void __alloc_tagging_slab_alloc_hook(struct kmem_cache *s, void *object,
+				     gfp_t flags);
+void __alloc_tagging_slab_free_hook(struct kmem_cache *s, void *object);
+
+static inline void alloc_tagging_slab_post_alloc_hook(struct kmem_cache *s,
+						       gfp_t flags, size_t size,
+						       void **p)
+{
+	size_t i;
+
+	if (!mem_alloc_profiling_enabled() || !current->alloc_tag)
+		return;
+
+	for (i = 0; i < size; i++)
+		if (likely(p[i]))
+			__alloc_tagging_slab_alloc_hook(s, p[i], flags);
+}
+
+static inline void alloc_tagging_slab_free_hook(struct kmem_cache *s,
+						void **p, int objects)
+{
+	int i;
+
+	if (!mem_alloc_profiling_enabled())
+		return;
+
+	for (i = 0; i < objects; i++)
+		if (likely(p[i]))
+			__alloc_tagging_slab_free_hook(s, p[i]);
+}
+#else /* CONFIG_MEM_ALLOC_PROFILING */
+static inline void alloc_tagging_slab_post_alloc_hook(struct kmem_cache *s,
+						       gfp_t flags, size_t size,
+						       void **p)
+{
+}
+
+static inline void alloc_tagging_slab_free_hook(struct kmem_cache *s,
+						void **p, int objects)
+{
+}
+#endif /* CONFIG_MEM_ALLOC_PROFILING */
+
 static inline struct kmem_cache *virt_to_cache(const void *obj)
 {
 	struct page *page;
@@ -449,8 +488,7 @@ static __always_inline void account_slab_page(struct page *page, int order,
 static __always_inline void unaccount_slab_page(struct page *page, int order,
 						struct kmem_cache *s)
 {
-	if (memcg_kmem_enabled())
-		memcg_free_page_obj_cgroups(page);
+	free_page_obj_exts(page);
 
 	mod_node_page_state(page_pgdat(page), cache_vmstat_idx(s),
 			    -(PAGE_SIZE << order));
@@ -537,6 +575,7 @@ static inline void slab_post_alloc_hook(struct kmem_cache *s,
 	}
 
 	memcg_slab_post_alloc_hook(s, objcg, flags, size, p);
+	alloc_tagging_slab_post_alloc_hook(s, flags, size, p);
 }
 
 #ifndef CONFIG_SLOB
@@ -129,6 +129,38 @@ int __kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t nr,
 	return i;
 }
 
+#if defined(CONFIG_MEMCG_KMEM) || defined(CONFIG_MEM_ALLOC_PROFILING)
+/*
+ * The allocated slabobj_ext array is neither accounted to a memcg nor
+ * tagged.  Moreover, it should not come from DMA buffer and is not readily
+ * reclaimable. So those GFP bits should be masked off.
+ */
+#define OBJEXTS_CLEAR_MASK	(__GFP_DMA | __GFP_RECLAIMABLE | __GFP_ACCOUNT)
+
+int alloc_page_obj_exts(struct page *page, struct kmem_cache *s, gfp_t gfp)
+{
+	unsigned int objects = objs_per_slab_page(s, page);
+	struct alloc_tag *tag;
+	void *vec;
+
+	gfp &= ~OBJEXTS_CLEAR_MASK;
+	tag = alloc_tag_save(NULL);
+	vec = kcalloc_node_noprof(objects, sizeof(struct slabobj_ext), gfp,
+				  page_to_nid(page));
+	alloc_tag_restore(tag);
+	if (!vec)
+		return -ENOMEM;
+
+	if (cmpxchg(&page->obj_exts, NULL,
+		    (struct slabobj_ext *)((unsigned long)vec | 0x1UL)))
+		kfree(vec);
+	else
+		kmemleak_not_leak(vec);
+
+	return 0;
+}
+#endif
+
 /*
  * Figure out what the alignment of the objects will be given a set of
  * flags, a user specified alignment and the size of the objects.
@@ -849,7 +881,7 @@ void *kmalloc_order(size_t size, gfp_t flags, unsigned int order)
 		flags = kmalloc_fix_flags(flags);
 
 	flags |= __GFP_COMP;
-	page = alloc_pages(flags, order);
+	page = alloc_pages_noprof(flags, order);
 	if (likely(page)) {
 		ret = page_address(page);
 		mod_lruvec_page_state(page, NR_SLAB_UNRECLAIMABLE_B,
@@ -407,6 +407,7 @@ struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
 
 		if (readahead) {
 			count_vm_event(SWAP_RA_HIT);
+			count_memcg_page_event(page, SWAP_RA_HIT);
 			if (!vma || !vma_ra)
 				atomic_inc(&swapin_readahead_hits);
 		}
@@ -567,44 +568,34 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return retpage;
 }
 
-static unsigned int __swapin_nr_pages(unsigned long prev_offset,
-				      unsigned long offset,
-				      int hits,
-				      int max_pages,
-				      int prev_win)
+/*
+ * Size the next readahead window from how well the previous one did:
+ * @hits of the @prev_win - 1 pages read ahead last time have been
+ * faulted on since.  The window grows while nearly all of them get used,
+ * shrinks quickly when most are wasted, and only opens up again once
+ * @pattern says the faults follow a sequential or strided pattern.
+ *
+ * Windows are always powers of two no larger than @max_pages.
+ */
+static unsigned int swapin_ra_window(unsigned int hits, unsigned int prev_win,
+				     unsigned int max_pages, bool pattern)
 {
-	unsigned int pages, last_ra;
+	unsigned int pages;
 
-	/*
-	 * This heuristic has been found to work well on both sequential and
-	 * random loads, swapping to hard disk or to SSD: please don't ask
-	 * what the "+ 2" means, it just happens to work well, that's all.
-	 */
-	pages = hits + 2;
-	if (pages == 2) {
-		/*
-		 * We can have no readahead hits to judge by: but must not get
-		 * stuck here forever, so check for an adjacent offset instead
-		 * (and don't even bother to check whether swap type is same).
-		 */
-		if (offset != prev_offset + 1 && offset != prev_offset - 1)
-			pages = 1;
+	if (prev_win <= 1) {
+		pages = pattern ? 4 : 1;
 	} else {
-		unsigned int roundup = 4;
-		while (roundup < pages)
-			roundup <<= 1;
-		pages = roundup;
+		unsigned int issued = prev_win - 1;
+
+		if (hits * 4 >= issued * 3)
+			pages = prev_win * 2;
+		else if (hits * 4 < issued)
+			pages = pattern ? prev_win / 2 : prev_win / 4;
+		else
+			pages = prev_win;
 	}
 
-	if (pages > max_pages)
-		pages = max_pages;
-
-	/* Don't shrink readahead too fast */
-	last_ra = prev_win / 2;
-	if (pages < last_ra)
-		pages = last_ra;
-
-	return pages;
+	return clamp(pages, 1U, max_pages);
 }
 
 static unsigned long swapin_nr_pages(unsigned long offset)
@@ -612,17 +603,20 @@ static unsigned long swapin_nr_pages(unsigned long offset)
 	static unsigned long prev_offset;
 	unsigned int hits, pages, max_pages;
 	static atomic_t last_readahead_pages;
+	unsigned long prev;
+	bool pattern;
 
 	max_pages = 1 << READ_ONCE(page_cluster);
 	if (max_pages <= 1)
 		return 1;
 
 	hits = atomic_xchg(&swapin_readahead_hits, 0);
-	pages = __swapin_nr_pages(READ_ONCE(prev_offset), offset, hits,
-				  max_pages,
-				  atomic_read(&last_readahead_pages));
-	if (!hits)
-		WRITE_ONCE(prev_offset, offset);
+	prev = READ_ONCE(prev_offset);
+	/* don't even bother to check whether swap type is same */
+	pattern = offset == prev + 1 || offset == prev - 1;
+	pages = swapin_ra_window(hits, atomic_read(&last_readahead_pages),
+				 max_pages, pattern);
+	WRITE_ONCE(prev_offset, offset);
 	atomic_set(&last_readahead_pages, pages);
 
 	return pages;
@@ -637,7 +631,8 @@ static unsigned long swapin_nr_pages(unsigned long offset)
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
+ * up to (1 << page_cluster) entries in the swap area, sized by the hit
+ * rate of earlier readahead. This method is chosen
  * because it doesn't cost us any seek time.  We also make sure to queue
  * the 'original' request together with the readahead ones...
  *
@@ -693,6 +688,7 @@ struct page *swap_cluster_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			if (offset != entry_offset) {
 				SetPageReadahead(page);
 				count_vm_event(SWAP_RA);
+				count_memcg_page_event(page, SWAP_RA);
 			}
 		}
 		put_page(page);
@@ -756,9 +752,12 @@ static void swap_ra_info(struct vm_fault *vmf,
 	unsigned long faddr, pfn, fpfn;
 	unsigned long start, end;
 	pte_t *pte, *orig_pte;
-	unsigned int max_win, hits, prev_win, win, left;
+	unsigned int max_win, hits, prev_win, win, left, step;
+	long stride, prev_stride;
+	bool pattern;
 #ifndef CONFIG_64BIT
 	pte_t *tpte;
+	unsigned int i;
 #endif
 
 	max_win = 1 << min_t(unsigned int, READ_ONCE(page_cluster),
@@ -781,8 +780,22 @@ static void swap_ra_info(struct vm_fault *vmf,
 	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
 	prev_win = SWAP_RA_WIN(ra_val);
 	hits = SWAP_RA_HITS(ra_val);
-	ra_info->win = win = __swapin_nr_pages(pfn, fpfn, hits,
-					       max_win, prev_win);
+
+	/*
+	 * Sequential faults in either direction are followed right away,
+	 * a larger stride only once two consecutive faults agree on it.
+	 * Anything else reads around the fault address.
+	 */
+	stride = (long)(fpfn - pfn);
+	if (abs(stride) > SWAP_RA_STRIDE_MAX)
+		stride = 0;
+	prev_stride = READ_ONCE(vma->swap_readahead_stride);
+	WRITE_ONCE(vma->swap_readahead_stride, stride);
+	if (abs(stride) != 1 && stride != prev_stride)
+		stride = 0;
+	pattern = stride != 0;
+
+	ra_info->win = win = swapin_ra_window(hits, prev_win, max_win, pattern);
 	atomic_long_set(&vma->swap_readahead_info,
 			SWAP_RA_VAL(faddr, win, 0));
 
@@ -792,25 +805,31 @@ static void swap_ra_info(struct vm_fault *vmf,
 	}
 
 	/* Copy the PTEs because the page table may be unmapped */
-	if (fpfn == pfn + 1)
-		swap_ra_clamp_pfn(vma, faddr, fpfn, fpfn + win, &start, &end);
-	else if (pfn == fpfn + 1)
-		swap_ra_clamp_pfn(vma, faddr, fpfn - win + 1, fpfn + 1,
+	step = stride ? abs(stride) : 1;
+	if (stride > 0) {
+		swap_ra_clamp_pfn(vma, faddr, fpfn, fpfn + (win - 1) * step + 1,
 				  &start, &end);
-	else {
+	} else if (stride < 0) {
+		swap_ra_clamp_pfn(vma, faddr, fpfn - (win - 1) * step, fpfn + 1,
+				  &start, &end);
+		/* stay in step with the fault address */
+		start = fpfn - (fpfn - start) / step * step;
+	} else {
 		left = (win - 1) / 2;
 		swap_ra_clamp_pfn(vma, faddr, fpfn - left, fpfn + win - left,
 				  &start, &end);
 	}
-	ra_info->nr_pte = end - start;
-	ra_info->offset = fpfn - start;
-	pte -= ra_info->offset;
+	ra_info->nr_pte = DIV_ROUND_UP(end - start, step);
+	ra_info->offset = (fpfn - start) / step;
+	pte -= fpfn - start;
 #ifdef CONFIG_64BIT
 	ra_info->ptes = pte;
+	ra_info->stride = step;
 #else
 	tpte = ra_info->ptes;
-	for (pfn = start; pfn != end; pfn++)
-		*tpte++ = *pte++;
+	for (i = 0; i < ra_info->nr_pte; i++, pte += step)
+		*tpte++ = *pte;
+	ra_info->stride = 1;
 #endif
 	pte_unmap(orig_pte);
 }
@@ -823,8 +842,10 @@ static void swap_ra_info(struct vm_fault *vmf,
  *
  * Returns the struct page for entry and addr, after queueing swapin.
  *
- * Primitive swap readahead code. We simply read in a few pages whoes
- * virtual addresses are around the fault address in the same vma.
+ * VMA based swap readahead: read in a few pages whose virtual addresses
+ * are around the fault address in the same vma, or that continue the
+ * sequential or strided pattern of the recent faults in this vma.  The
+ * window adapts to how many of the pages read ahead last time were used.
  *
  * Caller must hold read mmap_lock if vmf->vma is not NULL.
  *
@@ -847,7 +868,7 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 
 	blk_start_plug(&plug);
 	for (i = 0, pte = ra_info.ptes; i < ra_info.nr_pte;
-	     i++, pte++) {
+	     i++, pte += ra_info.stride) {
 		pentry = *pte;
 		if (pte_none(pentry))
 			continue;
@@ -865,6 +886,7 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 			if (i != ra_info.offset) {
 				SetPageReadahead(page);
 				count_vm_event(SWAP_RA);
+				count_memcg_page_event(page, SWAP_RA);
 			}
 		}
 		put_page(page);
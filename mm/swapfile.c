@@ -233,6 +233,18 @@ sector_t swap_page_sector(struct page *page)
 	return sector << (PAGE_SHIFT - 9);
 }
 
+/*
+ * Whether [@offset, @offset + @nr_pages) is backed by one contiguous run
+ * of disk blocks, so that it can be written out with a single bio.
+ */
+static bool swap_range_contiguous(struct swap_info_struct *si,
+				  unsigned long offset, unsigned long nr_pages)
+{
+	struct swap_extent *se = offset_to_swap_extent(si, offset);
+
+	return offset + nr_pages <= se->start_page + se->nr_pages;
+}
+
 /*
  * swap allocation tell device that a cluster of swap can now be discarded,
  * to allow the swap device to optimize its wear-levelling.
@@ -767,6 +779,54 @@ static void set_cluster_next(struct swap_info_struct *si, unsigned long next)
 	this_cpu_write(*si->cluster_next_cpu, next);
 }
 
+/*
+ * Fast path for the SSD algorithm: hand out a run of free slots from the
+ * current cpu's cluster with a single cluster lock round trip, rather than
+ * locking, checking and accounting one slot at a time.  Returns the number
+ * of slots allocated; the caller falls back to the slow path for the rest.
+ */
+static int scan_swap_map_ssd_cluster_batch(struct swap_info_struct *si,
+					   unsigned char usage, int nr,
+					   swp_entry_t slots[])
+{
+	struct percpu_cluster *cluster;
+	struct swap_cluster_info *ci;
+	unsigned long offset, max;
+	int i, n_ret = 0;
+
+	if (!(si->flags & SWP_WRITEOK) || !si->highest_bit)
+		return 0;
+
+	cluster = this_cpu_ptr(si->percpu_cluster);
+	if (cluster_is_null(&cluster->index))
+		return 0;
+
+	offset = cluster->next;
+	max = min_t(unsigned long, si->max,
+		    (cluster_next(&cluster->index) + 1) * SWAPFILE_CLUSTER);
+	if (offset >= max || scan_swap_map_ssd_cluster_conflict(si, offset))
+		return 0;
+
+	ci = lock_cluster(si, offset);
+	for (; offset < max && n_ret < nr; offset++) {
+		if (si->swap_map[offset])
+			continue;
+		WRITE_ONCE(si->swap_map[offset], usage);
+		inc_cluster_info_page(si, si->cluster_info, offset);
+		slots[n_ret++] = swp_entry(si->type, offset);
+	}
+	unlock_cluster(ci);
+
+	cluster->next = offset;
+	if (offset >= max)
+		cluster_set_null(&cluster->index);
+
+	for (i = 0; i < n_ret; i++)
+		swap_range_alloc(si, swp_offset(slots[i]), 1);
+
+	return n_ret;
+}
+
 static int scan_swap_map_slots(struct swap_info_struct *si,
 			       unsigned char usage, int nr,
 			       swp_entry_t slots[])
@@ -804,8 +864,17 @@ static int scan_swap_map_slots(struct swap_info_struct *si,
 
 	/* SSD algorithm */
 	if (si->cluster_info) {
-		if (!scan_swap_map_try_ssd_cluster(si, &offset, &scan_base))
+		n_ret = scan_swap_map_ssd_cluster_batch(si, usage, nr, slots);
+		if (n_ret) {
+			offset = swp_offset(slots[n_ret - 1]);
+			if (n_ret == nr || offset >= si->highest_bit)
+				goto done;
+		}
+		if (!scan_swap_map_try_ssd_cluster(si, &offset, &scan_base)) {
+			if (n_ret)
+				goto done;
 			goto scan;
+		}
 	} else if (unlikely(!si->cluster_nr--)) {
 		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER) {
 			si->cluster_nr = SWAPFILE_CLUSTER - 1;
@@ -1000,11 +1069,27 @@ static int swap_alloc_cluster(struct swap_info_struct *si, swp_entry_t *slot)
 		return 0;
 	}
 
-	if (cluster_list_empty(&si->free_clusters))
-		return 0;
+	if (cluster_list_empty(&si->free_clusters)) {
+		/*
+		 * Don't fall back to splitting the huge page while whole
+		 * clusters are only waiting for their discard to finish.
+		 */
+		if (cluster_list_empty(&si->discard_clusters))
+			return 0;
+		swap_do_scheduled_discard(si);
+		if (cluster_list_empty(&si->free_clusters) ||
+		    !(si->flags & SWP_WRITEOK))
+			return 0;
+	}
 
 	idx = cluster_list_first(&si->free_clusters);
 	offset = idx * SWAPFILE_CLUSTER;
+
+	/* The huge page is written with a single bio */
+	if (!(si->flags & SWP_BLKDEV) &&
+	    !swap_range_contiguous(si, offset, SWAPFILE_CLUSTER))
+		return 0;
+
 	ci = lock_cluster(si, offset);
 	alloc_cluster(si, idx);
 	cluster_set_count_flag(ci, SWAPFILE_CLUSTER, CLUSTER_FLAG_HUGE);
@@ -1094,13 +1179,14 @@ start_over:
 			goto nextsi;
 		}
 		if (size == SWAPFILE_CLUSTER) {
-			if (si->flags & SWP_BLKDEV)
+			if (si->cluster_info && !(si->flags & SWP_FS_OPS))
 				n_ret = swap_alloc_cluster(si, swp_entries);
 		} else
 			n_ret = scan_swap_map_slots(si, SWAP_HAS_CACHE,
 						    n_goal, swp_entries);
 		spin_unlock(&si->lock);
-		if (n_ret || size == SWAPFILE_CLUSTER)
+		/* a huge page may still find a free cluster on the next device */
+		if (n_ret)
 			goto check_out;
 		pr_debug("scan_swap_map of si %d failed to find offset\n",
 			si->type);
@@ -558,7 +558,7 @@ EXPORT_SYMBOL(vm_mmap);
  *
  * Return: pointer to the allocated memory of %NULL in case of failure
  */
-void *kvmalloc_node(size_t size, gfp_t flags, int node)
+void *kvmalloc_node_noprof(size_t size, gfp_t flags, int node)
 {
 	gfp_t kmalloc_flags = flags;
 	void *ret;
@@ -568,7 +568,7 @@ void *kvmalloc_node(size_t size, gfp_t flags, int node)
 	 * so the given set of flags has to be compatible.
 	 */
 	if ((flags & GFP_KERNEL) != GFP_KERNEL)
-		return kmalloc_node(size, flags, node);
+		return kmalloc_node_noprof(size, flags, node);
 
 	/*
 	 * We want to attempt a large physically contiguous block first because
@@ -584,7 +584,7 @@ void *kvmalloc_node(size_t size, gfp_t flags, int node)
 			kmalloc_flags |= __GFP_NORETRY;
 	}
 
-	ret = kmalloc_node(size, kmalloc_flags, node);
+	ret = kmalloc_node_noprof(size, kmalloc_flags, node);
 
 	/*
 	 * It doesn't really make sense to fallback to vmalloc for sub page
@@ -602,7 +602,7 @@ void *kvmalloc_node(size_t size, gfp_t flags, int node)
 	return __vmalloc_node(size, 1, flags, node,
 			__builtin_return_address(0));
 }
-EXPORT_SYMBOL(kvmalloc_node);
+EXPORT_SYMBOL(kvmalloc_node_noprof);
 
 /**
  * kvfree() - Free memory.
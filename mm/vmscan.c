@@ -73,6 +73,9 @@ struct scan_control {
 	 */
 	nodemask_t	*nodemask;
 
+	/* Swappiness value for proactive reclaim. Always use sc_swappiness()! */
+	int *proactive_swappiness;
+
 	/*
 	 * The memory cgroup that hit its limit and as a result is the
 	 * primary target of this reclaim invocation.
@@ -2231,6 +2234,13 @@ enum scan_balance {
 	SCAN_FILE,
 };
 
+static int sc_swappiness(struct scan_control *sc, struct mem_cgroup *memcg)
+{
+	if (sc->proactive_swappiness)
+		return *sc->proactive_swappiness;
+	return mem_cgroup_swappiness(memcg);
+}
+
 /*
  * Determine how aggressively the anon and file LRU lists should be
  * scanned.  The relative value of each set of LRU lists is determined
@@ -2246,7 +2256,7 @@ static void get_scan_count(struct lruvec *lruvec, struct scan_control *sc,
 {
 	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
 	unsigned long anon_cost, file_cost, total_cost;
-	int swappiness = mem_cgroup_swappiness(memcg);
+	int swappiness = sc_swappiness(sc, memcg);
 	u64 fraction[ANON_AND_FILE];
 	u64 denominator = 0;	/* gcc */
 	enum scan_balance scan_balance;
@@ -3330,10 +3340,23 @@ unsigned long mem_cgroup_shrink_node(struct mem_cgroup *memcg,
 	return sc.nr_reclaimed;
 }
 
-unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
-					   unsigned long nr_pages,
-					   gfp_t gfp_mask,
-					   bool may_swap)
+/**
+ * try_to_free_mem_cgroup_pages_nodemask - reclaim pages from a memcg
+ * @memcg: the cgroup to reclaim from, including its descendants
+ * @nr_pages: the number of pages to reclaim
+ * @gfp_mask: the reclaim context
+ * @may_swap: whether anonymous pages may be swapped out
+ * @swappiness: if not NULL, overrides the swappiness of the cgroups
+ * @nodemask: if not NULL, only reclaim from these nodes
+ *
+ * Returns the number of pages reclaimed.
+ */
+unsigned long try_to_free_mem_cgroup_pages_nodemask(struct mem_cgroup *memcg,
+						    unsigned long nr_pages,
+						    gfp_t gfp_mask,
+						    bool may_swap,
+						    int *swappiness,
+						    nodemask_t *nodemask)
 {
 	unsigned long nr_reclaimed;
 	unsigned int noreclaim_flag;
@@ -3343,6 +3366,8 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 				(GFP_HIGHUSER_MOVABLE & ~GFP_RECLAIM_MASK),
 		.reclaim_idx = MAX_NR_ZONES - 1,
 		.target_mem_cgroup = memcg,
+		.nodemask = nodemask,
+		.proactive_swappiness = swappiness,
 		.priority = DEF_PRIORITY,
 		.may_writepage = !laptop_mode,
 		.may_unmap = 1,
@@ -3367,6 +3392,15 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 
 	return nr_reclaimed;
 }
+
+unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
+					   unsigned long nr_pages,
+					   gfp_t gfp_mask,
+					   bool may_swap)
+{
+	return try_to_free_mem_cgroup_pages_nodemask(memcg, nr_pages, gfp_mask,
+						     may_swap, NULL, NULL);
+}
 #endif
 
 static void age_active_anon(struct pglist_data *pgdat,
@@ -23,6 +23,7 @@
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
 #include <linux/sched.h>
+#include <linux/tick.h>
 #include <linux/math64.h>
 #include <linux/writeback.h>
 #include <linux/compaction.h>
@@ -171,6 +172,69 @@ EXPORT_SYMBOL(vm_node_stat);
 
 #ifdef CONFIG_SMP
 
+/*
+ * In quiet mode no vmstat work is ever queued on nohz_full CPUs: they fold
+ * their differentials themselves when they stop the tick or return to user
+ * space, see quiet_vmstat(), and /proc/vmstat adds what is still pending
+ * on them.
+ */
+int sysctl_stat_nohz_full_quiet __read_mostly = 1;
+
+bool vmstat_quiet_cpu(int cpu)
+{
+	return READ_ONCE(sysctl_stat_nohz_full_quiet) && tick_nohz_full_cpu(cpu);
+}
+
+static inline bool vmstat_quiet_cpus(void)
+{
+	return READ_ONCE(sysctl_stat_nohz_full_quiet) && tick_nohz_full_enabled();
+}
+
+/*
+ * Set by the counter updates, cleared when the differentials of the cpu are
+ * folded: quiet_vmstat() runs on every return to user space of a quiet
+ * cpu, and must not scan all the differentials each time.
+ */
+static DEFINE_PER_CPU(bool, vmstat_dirty);
+
+static inline void vmstat_mark_dirty(void)
+{
+	this_cpu_write(vmstat_dirty, true);
+}
+
+/*
+ * Exact versions of global_zone_page_state() and
+ * global_node_page_state_pages(): add the differentials still pending on
+ * every cpu, which can be up to stat_threshold pages per cpu and zone or
+ * node.  Much more expensive, for the readers that need it.
+ */
+unsigned long global_zone_page_state_snapshot(enum zone_stat_item item)
+{
+	long x = atomic_long_read(&vm_zone_stat[item]);
+	struct zone *zone;
+	int cpu;
+
+	for_each_populated_zone(zone)
+		for_each_online_cpu(cpu)
+			x += per_cpu_ptr(zone->pageset, cpu)->vm_stat_diff[item];
+
+	return x < 0 ? 0 : x;
+}
+
+unsigned long global_node_page_state_snapshot(enum node_stat_item item)
+{
+	long x = atomic_long_read(&vm_node_stat[item]);
+	struct pglist_data *pgdat;
+	int cpu;
+
+	for_each_online_pgdat(pgdat)
+		for_each_online_cpu(cpu)
+			x += per_cpu_ptr(pgdat->per_cpu_nodestats,
+					 cpu)->vm_node_stat_diff[item];
+
+	return x < 0 ? 0 : x;
+}
+
 int calculate_pressure_threshold(struct zone *zone)
 {
 	int threshold;
@@ -332,6 +396,7 @@ void __mod_zone_page_state(struct zone *zone, enum zone_stat_item item,
 		x = 0;
 	}
 	__this_cpu_write(*p, x);
+	vmstat_mark_dirty();
 }
 EXPORT_SYMBOL(__mod_zone_page_state);
 
@@ -357,6 +422,7 @@ void __mod_node_page_state(struct pglist_data *pgdat, enum node_stat_item item,
 		x = 0;
 	}
 	__this_cpu_write(*p, x);
+	vmstat_mark_dirty();
 }
 EXPORT_SYMBOL(__mod_node_page_state);
 
@@ -397,6 +463,7 @@ void __inc_zone_state(struct zone *zone, enum zone_stat_item item)
 		zone_page_state_add(v + overstep, zone, item);
 		__this_cpu_write(*p, -overstep);
 	}
+	vmstat_mark_dirty();
 }
 
 void __inc_node_state(struct pglist_data *pgdat, enum node_stat_item item)
@@ -415,6 +482,7 @@ void __inc_node_state(struct pglist_data *pgdat, enum node_stat_item item)
 		node_page_state_add(v + overstep, pgdat, item);
 		__this_cpu_write(*p, -overstep);
 	}
+	vmstat_mark_dirty();
 }
 
 void __inc_zone_page_state(struct page *page, enum zone_stat_item item)
@@ -443,6 +511,7 @@ void __dec_zone_state(struct zone *zone, enum zone_stat_item item)
 		zone_page_state_add(v - overstep, zone, item);
 		__this_cpu_write(*p, overstep);
 	}
+	vmstat_mark_dirty();
 }
 
 void __dec_node_state(struct pglist_data *pgdat, enum node_stat_item item)
@@ -461,6 +530,7 @@ void __dec_node_state(struct pglist_data *pgdat, enum node_stat_item item)
 		node_page_state_add(v - overstep, pgdat, item);
 		__this_cpu_write(*p, overstep);
 	}
+	vmstat_mark_dirty();
 }
 
 void __dec_zone_page_state(struct page *page, enum zone_stat_item item)
@@ -522,6 +592,12 @@ static inline void mod_zone_state(struct zone *zone,
 		}
 	} while (this_cpu_cmpxchg(*p, o, n) != o);
 
+	/*
+	 * This marks the wrong cpu if we were rescheduled after the cmpxchg.
+	 * The next update on the cpu whose differential changed marks it.
+	 */
+	vmstat_mark_dirty();
+
 	if (z)
 		zone_page_state_add(z, zone, item);
 }
@@ -584,6 +660,9 @@ static inline void mod_node_state(struct pglist_data *pgdat,
 		}
 	} while (this_cpu_cmpxchg(*p, o, n) != o);
 
+	/* See mod_zone_state() */
+	vmstat_mark_dirty();
+
 	if (z)
 		node_page_state_add(z, pgdat, item);
 }
@@ -770,6 +849,9 @@ static int refresh_cpu_vm_stats(bool do_pagesets)
 	int global_node_diff[NR_VM_NODE_STAT_ITEMS] = { 0, };
 	int changes = 0;
 
+	/* Before the folding, so that updates racing with it mark it again */
+	this_cpu_write(vmstat_dirty, false);
+
 	for_each_populated_zone(zone) {
 		struct per_cpu_pageset __percpu *p = zone->pageset;
 
@@ -871,6 +953,8 @@ void cpu_vm_stats_fold(int cpu)
 #endif
 	int global_node_diff[NR_VM_NODE_STAT_ITEMS] = { 0, };
 
+	per_cpu(vmstat_dirty, cpu) = false;
+
 	for_each_populated_zone(zone) {
 		struct per_cpu_pageset *p;
 
@@ -949,6 +1033,13 @@ void drain_zonestat(struct zone *zone, struct per_cpu_pageset *pset)
 		}
 #endif
 }
+#else
+static inline bool vmstat_quiet_cpus(void)
+{
+	return false;
+}
+
+static inline void vmstat_mark_dirty(void) { }
 #endif
 
 #ifdef CONFIG_NUMA
@@ -965,6 +1056,7 @@ void __inc_numa_state(struct zone *zone,
 		zone_numa_state_add(v, zone, item);
 		__this_cpu_write(*p, 0);
 	}
+	vmstat_mark_dirty();
 }
 
 /*
@@ -1269,6 +1361,11 @@ const char * const vmstat_text[] = {
 	"drop_pagecache",
 	"drop_slab",
 	"oom_kill",
+	"dirty_pause_le_4ms",
+	"dirty_pause_le_16ms",
+	"dirty_pause_le_64ms",
+	"dirty_pause_gt_64ms",
+	"dirty_pause_ms",
 
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",
@@ -1294,6 +1391,10 @@ const char * const vmstat_text[] = {
 	"compact_daemon_wake",
 	"compact_daemon_migrate_scanned",
 	"compact_daemon_free_scanned",
+	"compact_proactive_wake",
+	"compact_proactive_migrate_scanned",
+	"compact_proactive_free_scanned",
+	"compact_proactive_throttled",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1352,6 +1453,18 @@ const char * const vmstat_text[] = {
 	"swap_ra",
 	"swap_ra_hit",
 #endif
+#ifdef CONFIG_MMU
+	"mremap_move_pud",
+	"mremap_move_pmd",
+	"mremap_move_pte",
+	"mremap_tlb_flush",
+#endif
+#ifdef CONFIG_PAGE_PREZERO
+	"prezero_alloc",
+	"prezero_alloc_huge",
+	"prezero_fill",
+	"prezero_drain",
+#endif
 #endif /* CONFIG_VM_EVENT_COUNTERS || CONFIG_MEMCG */
 };
 #endif /* CONFIG_PROC_FS || CONFIG_SYSFS || CONFIG_NUMA || CONFIG_MEMCG */
@@ -1725,6 +1838,7 @@ static const struct seq_operations zoneinfo_op = {
 
 static void *vmstat_start(struct seq_file *m, loff_t *pos)
 {
+	bool exact = vmstat_quiet_cpus();
 	unsigned long *v;
 	int i;
 
@@ -1736,8 +1850,10 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 	m->private = v;
 	if (!v)
 		return ERR_PTR(-ENOMEM);
+	/* Nobody folds the counters of quiet CPUs on their behalf */
 	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
-		v[i] = global_zone_page_state(i);
+		v[i] = exact ? global_zone_page_state_snapshot(i) :
+			       global_zone_page_state(i);
 	v += NR_VM_ZONE_STAT_ITEMS;
 
 #ifdef CONFIG_NUMA
@@ -1747,7 +1863,8 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 #endif
 
 	for (i = 0; i < NR_VM_NODE_STAT_ITEMS; i++)
-		v[i] = global_node_page_state_pages(i);
+		v[i] = exact ? global_node_page_state_snapshot(i) :
+			       global_node_page_state_pages(i);
 	v += NR_VM_NODE_STAT_ITEMS;
 
 	global_dirty_limits(v + NR_DIRTY_BG_THRESHOLD,
@@ -1813,6 +1930,37 @@ static void refresh_vm_stats(struct work_struct *work)
 	refresh_cpu_vm_stats(true);
 }
 
+/*
+ * schedule_on_each_cpu(refresh_vm_stats), leaving out the quiet nohz_full
+ * CPUs: they fold their differentials on their next return to user space.
+ */
+static int refresh_vm_stats_on_cpus(void)
+{
+	struct work_struct __percpu *works;
+	int cpu;
+
+	works = alloc_percpu(struct work_struct);
+	if (!works)
+		return -ENOMEM;
+
+	get_online_cpus();
+
+	for_each_online_cpu(cpu) {
+		struct work_struct *work = per_cpu_ptr(works, cpu);
+
+		INIT_WORK(work, refresh_vm_stats);
+		if (!vmstat_quiet_cpu(cpu))
+			schedule_work_on(cpu, work);
+	}
+
+	for_each_online_cpu(cpu)
+		flush_work(per_cpu_ptr(works, cpu));
+
+	put_online_cpus();
+	free_percpu(works);
+	return 0;
+}
+
 int vmstat_refresh(struct ctl_table *table, int write,
 		   void *buffer, size_t *lenp, loff_t *ppos)
 {
@@ -1832,7 +1980,7 @@ int vmstat_refresh(struct ctl_table *table, int write,
 	 * transiently negative values, report an error here if any of
 	 * the stats is negative, so we know to go looking for imbalance.
 	 */
-	err = schedule_on_each_cpu(refresh_vm_stats);
+	err = refresh_vm_stats_on_cpus();
 	if (err)
 		return err;
 	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++) {
@@ -1865,7 +2013,12 @@ int vmstat_refresh(struct ctl_table *table, int write,
 
 static void vmstat_update(struct work_struct *w)
 {
-	if (refresh_cpu_vm_stats(true)) {
+	/*
+	 * A quiet nohz_full cpu folds its own counters, do not keep the
+	 * worker interrupting it.
+	 */
+	if (refresh_cpu_vm_stats(true) &&
+	    !vmstat_quiet_cpu(smp_processor_id())) {
 		/*
 		 * Counters were updated so we expect more updates
 		 * to occur in the future. Keep on running the
@@ -1916,17 +2069,20 @@ static bool need_update(int cpu)
 /*
  * Switch off vmstat processing and then fold all the remaining differentials
  * until the diffs stay at zero. The function is used by NOHZ and can only be
- * invoked when tick processing is not active.
+ * invoked when tick processing is not active.  Quiet nohz_full CPUs also
+ * call it on every return to user space, see vm.stat_nohz_full_quiet.
  */
 void quiet_vmstat(void)
 {
 	if (system_state != SYSTEM_RUNNING)
 		return;
 
-	if (!delayed_work_pending(this_cpu_ptr(&vmstat_work)))
+	/* No worker is going to fold the counters of a quiet cpu */
+	if (!delayed_work_pending(this_cpu_ptr(&vmstat_work)) &&
+	    !vmstat_quiet_cpu(smp_processor_id()))
 		return;
 
-	if (!need_update(smp_processor_id()))
+	if (!__this_cpu_read(vmstat_dirty))
 		return;
 
 	/*
@@ -1957,6 +2113,9 @@ static void vmstat_shepherd(struct work_struct *w)
 	for_each_online_cpu(cpu) {
 		struct delayed_work *dw = &per_cpu(vmstat_work, cpu);
 
+		if (vmstat_quiet_cpu(cpu))
+			continue;
+
 		if (!delayed_work_pending(dw) && need_update(cpu))
 			queue_delayed_work_on(cpu, mm_percpu_wq, dw, 0);
 	}
@@ -879,6 +879,154 @@ static void test_seal_resize(void)
 	close(fd);
 }
 
+static unsigned long thp_size(void)
+{
+	unsigned long size = 0;
+	FILE *f;
+
+	f = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%lu", &size) != 1)
+		size = 0;
+	fclose(f);
+
+	return size;
+}
+
+/* Bytes of the mapping at @addr that are mapped by PMDs, from smaps */
+static unsigned long file_pmd_mapped(void *addr)
+{
+	unsigned long start, end, kb = 0;
+	char line[256];
+	int found = 0;
+	FILE *f;
+
+	f = fopen("/proc/self/smaps", "r");
+	if (!f) {
+		printf("fopen(/proc/self/smaps) failed: %m\n");
+		abort();
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+			found = start == (unsigned long)addr;
+		else if (found &&
+			 sscanf(line, "FilePmdMapped: %lu kB", &kb) == 1)
+			break;
+	}
+	fclose(f);
+
+	return kb << 10;
+}
+
+/*
+ * Test MFD_HUGEPAGE and SEAL_NOSPLIT
+ * Test whether MFD_HUGEPAGE memfds are mapped at huge page aligned
+ * addresses and backed by PMD mapped huge pages, whether punching holes in
+ * huge pages that cannot be split still leaves zeroes behind, and whether
+ * those huge pages then still are huge.
+ */
+static void test_hugepage(void)
+{
+	unsigned long hpage_size = thp_size();
+	struct stat st;
+	char *p;
+	int fd, r;
+
+	printf("%s HUGEPAGE\n", memfd_str);
+
+	/* hugetlbfs and transparent huge pages are exclusive */
+	mfd_fail_new("kern_memfd_hugepage", MFD_HUGEPAGE | MFD_HUGETLB);
+
+	fd = sys_memfd_create("kern_memfd_hugepage",
+			      MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGEPAGE);
+	if (fd < 0 || !hpage_size) {
+		printf("%s HUGEPAGE skipped: no transparent huge pages\n",
+		       memfd_str);
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+
+	/* size, populate and seal in one go */
+	r = ftruncate(fd, 2 * hpage_size);
+	if (r < 0) {
+		printf("ftruncate(%lu) failed: %m\n", 2 * hpage_size);
+		abort();
+	}
+	r = fallocate(fd, 0, 0, 2 * hpage_size);
+	if (r < 0) {
+		printf("fallocate(ALLOC) failed: %m\n");
+		abort();
+	}
+	/* the memlock charge is for the size, which must be sealed too */
+	mfd_fail_add_seals(fd, F_SEAL_NOSPLIT);
+	r = fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_NOSPLIT);
+	if (r < 0 && errno == ENOMEM) {
+		printf("%s HUGEPAGE skipped: RLIMIT_MEMLOCK below %lu\n",
+		       memfd_str, 2 * hpage_size);
+		close(fd);
+		return;
+	} else if (r < 0) {
+		printf("ADD_SEALS(%d, NOSPLIT) failed: %m\n", fd);
+		abort();
+	}
+	mfd_assert_has_seals(fd, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_NOSPLIT);
+
+	r = fstat(fd, &st);
+	if (r < 0) {
+		printf("fstat(%d) failed: %m\n", fd);
+		abort();
+	} else if (st.st_blksize != hpage_size) {
+		printf("wrong block size %ld, but expected %lu\n",
+		       (long)st.st_blksize, hpage_size);
+		abort();
+	}
+
+	p = mmap(NULL, 2 * hpage_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		 fd, 0);
+	if (p == MAP_FAILED) {
+		printf("mmap() failed: %m\n");
+		abort();
+	}
+	if ((unsigned long)p & (hpage_size - 1)) {
+		printf("mmap() returned %p, not aligned to %lu\n",
+		       p, hpage_size);
+		abort();
+	}
+
+	memset(p, 0x55, 2 * hpage_size);
+	if (file_pmd_mapped(p) != 2 * hpage_size) {
+		printf("%lu bytes mapped by PMDs, but expected %lu\n",
+		       file_pmd_mapped(p), 2 * hpage_size);
+		abort();
+	}
+
+	/* the first huge page cannot be split: the hole must still read 0 */
+	r = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		      hpage_size / 2, hpage_size / 4);
+	if (r < 0) {
+		printf("fallocate(PUNCH_HOLE) failed: %m\n");
+		abort();
+	}
+	if (p[hpage_size / 2] || p[hpage_size / 2 + hpage_size / 4 - 1] ||
+	    p[hpage_size / 2 - 1] != 0x55 ||
+	    p[hpage_size / 2 + hpage_size / 4] != 0x55) {
+		printf("PUNCH_HOLE in a huge page left the wrong content\n");
+		abort();
+	}
+
+	/* the hole unmapped the first huge page: it must fault back in whole */
+	p[0] = 0x55;
+	if (file_pmd_mapped(p) != 2 * hpage_size) {
+		printf("SEAL_NOSPLIT huge page was split by PUNCH_HOLE\n");
+		abort();
+	}
+
+	munmap(p, 2 * hpage_size);
+	close(fd);
+}
+
 /*
  * Test sharing via dup()
  * Test that seals are shared between dupped FDs and they're all equal.
@@ -1059,6 +1207,9 @@ int main(int argc, char **argv)
 	test_seal_grow();
 	test_seal_resize();
 
+	if (!hugetlbfs_test)
+		test_hugepage();
+
 	test_share_dup("SHARE-DUP", "");
 	test_share_mmap("SHARE-MMAP", "");
 	test_share_open("SHARE-OPEN", "");
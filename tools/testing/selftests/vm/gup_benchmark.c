@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -13,6 +14,7 @@
 
 #define MB (1UL << 20)
 #define PAGE_SIZE sysconf(_SC_PAGESIZE)
+#define PMD_SIZE (2 * MB)
 
 #define GUP_FAST_BENCHMARK	_IOWR('g', 1, struct gup_benchmark)
 #define GUP_BENCHMARK		_IOWR('g', 2, struct gup_benchmark)
@@ -35,16 +37,35 @@ struct gup_benchmark {
 	__u64 expansion[10];	/* For future use */
 };
 
+static int fd, cmd = GUP_FAST_BENCHMARK;
+
+struct gup_thread {
+	pthread_t thread;
+	struct gup_benchmark gup;
+	int ret;
+};
+
+/* Each thread pins and unpins its own slice of the buffer */
+static void *gup_thread(void *arg)
+{
+	struct gup_thread *t = arg;
+
+	t->ret = ioctl(fd, cmd, &t->gup);
+	return NULL;
+}
+
 int main(int argc, char **argv)
 {
-	struct gup_benchmark gup;
-	unsigned long size = 128 * MB;
-	int i, fd, filed, opt, nr_pages = 1, thp = -1, repeats = 1, write = 0;
-	int cmd = GUP_FAST_BENCHMARK, flags = MAP_PRIVATE;
+	struct gup_benchmark gup = { 0 };
+	struct gup_thread *threads;
+	unsigned long size = 128 * MB, slice;
+	int i, j, filed, opt, nr_pages = 1, thp = -1, repeats = 1, write = 0;
+	int nthreads = 1, pte_mapped = 0;
+	int flags = MAP_PRIVATE;
 	char *file = "/dev/zero";
 	char *p;
 
-	while ((opt = getopt(argc, argv, "m:r:n:f:abtTLUuwSH")) != -1) {
+	while ((opt = getopt(argc, argv, "m:r:n:f:j:abtTpLUuwSH")) != -1) {
 		switch (opt) {
 		case 'a':
 			cmd = PIN_FAST_BENCHMARK;
@@ -70,6 +91,14 @@ int main(int argc, char **argv)
 		case 'T':
 			thp = 0;
 			break;
+		case 'p':
+			/* THPs mapped by ptes rather than by a pmd */
+			thp = 1;
+			pte_mapped = 1;
+			break;
+		case 'j':
+			nthreads = atoi(optarg);
+			break;
 		case 'U':
 			cmd = GUP_BENCHMARK;
 			break;
@@ -125,18 +154,59 @@ int main(int argc, char **argv)
 	for (; (unsigned long)p < gup.addr + size; p += PAGE_SIZE)
 		p[0] = 0;
 
+	/*
+	 * Changing the protection of one subpage splits the pmd mapping of
+	 * each THP, but leaves the THP itself intact.
+	 */
+	if (pte_mapped) {
+		for (p = (char *)gup.addr; (unsigned long)p < gup.addr + size;
+		     p += PMD_SIZE) {
+			mprotect(p, PAGE_SIZE, PROT_READ);
+			mprotect(p, PAGE_SIZE, PROT_READ | PROT_WRITE);
+		}
+	}
+
+	if (nthreads < 1)
+		nthreads = 1;
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads) {
+		perror("calloc");
+		exit(1);
+	}
+	slice = size / nthreads / PAGE_SIZE * PAGE_SIZE;
+
 	for (i = 0; i < repeats; i++) {
-		gup.size = size;
-		if (ioctl(fd, cmd, &gup)) {
-			perror("ioctl");
-			exit(1);
+		for (j = 0; j < nthreads; j++) {
+			threads[j].gup = gup;
+			threads[j].gup.addr = gup.addr + j * slice;
+			threads[j].gup.size = j == nthreads - 1 ?
+					      size - j * slice : slice;
+			if (pthread_create(&threads[j].thread, NULL,
+					   gup_thread, &threads[j])) {
+				perror("pthread_create");
+				exit(1);
+			}
 		}
 
-		printf("Time: get:%lld put:%lld us", gup.get_delta_usec,
-			gup.put_delta_usec);
-		if (gup.size != size)
-			printf(", truncated (size: %lld)", gup.size);
-		printf("\n");
+		for (j = 0; j < nthreads; j++) {
+			struct gup_benchmark *g = &threads[j].gup;
+			unsigned long expected;
+
+			pthread_join(threads[j].thread, NULL);
+			if (threads[j].ret) {
+				perror("ioctl");
+				exit(1);
+			}
+
+			expected = j == nthreads - 1 ? size - j * slice : slice;
+			if (nthreads > 1)
+				printf("Thread %d: ", j);
+			printf("Time: get:%lld put:%lld us", g->get_delta_usec,
+				g->put_delta_usec);
+			if (g->size != expected)
+				printf(", truncated (size: %lld)", g->size);
+			printf("\n");
+		}
 	}
 
 	return 0;
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure the bandwidth of page migration between two NUMA nodes.
+ *
+ * An anonymous buffer is moved back and forth between node 0 and node 1
+ * with move_pages(2) while reader threads keep it mapped in the TLBs of
+ * other CPUs, which is the case where batching the TLB shootdowns of the
+ * migration pays off.  With -H the buffer is backed by THPs, to measure
+ * the huge page copy (see vm.migrate_copy_threads).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "../kselftest.h"
+
+#define MPOL_MF_MOVE	(1 << 1)
+
+static char *buf;
+static size_t size = 256UL << 20;
+static unsigned long page_size;
+static volatile int stop;
+
+static long move_pages(unsigned long count, void **pages, const int *nodes,
+		       int *status)
+{
+	return syscall(__NR_move_pages, 0, count, pages, nodes, status,
+		       MPOL_MF_MOVE);
+}
+
+static void *reader(void *arg)
+{
+	unsigned long sum = 0;
+	size_t off;
+
+	while (!stop)
+		for (off = 0; off < size && !stop; off += page_size)
+			sum += *(volatile char *)(buf + off);
+
+	return (void *)sum;
+}
+
+/*
+ * Is @node in the N_MEMORY node list, e.g. "0-1,3"?  A node without
+ * memory, like a CPU-only node, cannot be a migration target.
+ */
+static int node_has_memory(int node)
+{
+	char list[256], *p = list;
+	FILE *f;
+
+	f = fopen("/sys/devices/system/node/has_memory", "r");
+	if (!f)
+		return 0;
+	if (!fgets(list, sizeof(list), f)) {
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+
+	while (*p) {
+		char *end;
+		long first, last;
+
+		first = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		last = first;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+		if (node >= first && node <= last)
+			return 1;
+		if (*end != ',')
+			break;
+		p = end + 1;
+	}
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-s size_mb] [-n iterations] [-t readers] [-H]\n",
+		prog);
+	exit(KSFT_FAIL);
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 4, nr_readers = 4, thp = 0;
+	unsigned long nr_pages, i, moved, total = 0;
+	pthread_t *readers;
+	double elapsed = 0;
+	void **pages;
+	int *nodes, *status;
+	int opt, iter;
+
+	while ((opt = getopt(argc, argv, "s:n:t:H")) != -1) {
+		switch (opt) {
+		case 's':
+			size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 't':
+			nr_readers = atoi(optarg);
+			break;
+		case 'H':
+			thp = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!node_has_memory(0) || !node_has_memory(1)) {
+		printf("Need memory on NUMA nodes 0 and 1, skipping\n");
+		return KSFT_SKIP;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	nr_pages = size / page_size;
+
+	buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		return KSFT_FAIL;
+	}
+	if (thp && madvise(buf, size, MADV_HUGEPAGE)) {
+		perror("madvise(MADV_HUGEPAGE)");
+		return KSFT_SKIP;
+	}
+	memset(buf, 1, size);
+
+	pages = malloc(nr_pages * sizeof(*pages));
+	nodes = malloc(nr_pages * sizeof(*nodes));
+	status = malloc(nr_pages * sizeof(*status));
+	readers = calloc(nr_readers, sizeof(*readers));
+	if (!pages || !nodes || !status || (nr_readers && !readers)) {
+		perror("malloc");
+		return KSFT_FAIL;
+	}
+	for (i = 0; i < nr_pages; i++)
+		pages[i] = buf + i * page_size;
+
+	for (i = 0; i < nr_readers; i++) {
+		if (pthread_create(&readers[i], NULL, reader, NULL)) {
+			perror("pthread_create");
+			return KSFT_FAIL;
+		}
+	}
+
+	for (iter = 0; iter < iterations * 2; iter++) {
+		double start;
+
+		for (i = 0; i < nr_pages; i++)
+			nodes[i] = !(iter & 1);
+
+		start = now();
+		if (move_pages(nr_pages, pages, nodes, status) < 0) {
+			if (errno == ENOSYS) {
+				printf("move_pages not supported, skipping\n");
+				return KSFT_SKIP;
+			}
+			perror("move_pages");
+			return KSFT_FAIL;
+		}
+		elapsed += now() - start;
+
+		for (moved = 0, i = 0; i < nr_pages; i++)
+			if (status[i] == nodes[i])
+				moved++;
+		total += moved;
+		printf("pass %d: %lu of %lu pages on node %d\n",
+		       iter, moved, nr_pages, nodes[0]);
+	}
+
+	stop = 1;
+	for (i = 0; i < nr_readers; i++)
+		pthread_join(readers[i], NULL);
+
+	if (!total) {
+		printf("No page could be migrated\n");
+		return KSFT_FAIL;
+	}
+
+	printf("migrated %lu MB in %.3f s: %.1f MB/s\n",
+	       (total * page_size) >> 20, elapsed,
+	       ((total * page_size) >> 20) / elapsed);
+
+	return KSFT_PASS;
+}
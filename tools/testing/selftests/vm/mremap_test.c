@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mremap() throughput test.
+ *
+ * Moves a populated anonymous region to a destination of a given
+ * alignment and reports how long the move took, together with the
+ * mremap_* counters of /proc/vmstat, which tell whether page tables
+ * were moved at the pud, pmd or pte level and how many TLB flushes
+ * that took.  The moved region is checked to still hold its data.
+ *
+ * The region is 64MB by default, -s sets its size in MB.  The 1GB aligned
+ * move, which needs at least a 1GB region, only runs with -p.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../kselftest.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE	0x100000
+#endif
+
+#define KB(x)	((unsigned long)(x) << 10)
+#define MB(x)	((unsigned long)(x) << 20)
+#define GB(x)	((unsigned long)(x) << 30)
+
+enum {
+	MOVE_PUD,
+	MOVE_PMD,
+	MOVE_PTE,
+	TLB_FLUSH,
+	NR_COUNTERS,
+};
+
+static const char * const counter_names[NR_COUNTERS] = {
+	"mremap_move_pud",
+	"mremap_move_pmd",
+	"mremap_move_pte",
+	"mremap_tlb_flush",
+};
+
+struct test {
+	const char *name;
+	unsigned long size;
+	unsigned long alignment;
+};
+
+static unsigned long page_size;
+
+/* Returns false if the kernel doesn't export the counters */
+static bool read_counters(unsigned long *counters)
+{
+	char name[64];
+	unsigned long val;
+	int i, found = 0;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return false;
+
+	while (fscanf(f, "%63s %lu", name, &val) == 2) {
+		for (i = 0; i < NR_COUNTERS; i++) {
+			if (!strcmp(name, counter_names[i])) {
+				counters[i] = val;
+				found++;
+			}
+		}
+	}
+	fclose(f);
+
+	return found == NR_COUNTERS;
+}
+
+/*
+ * Find a free area of @size bytes whose start is @alignment aligned but
+ * not (2 * @alignment) aligned, so that every test really exercises the
+ * alignment it names.
+ */
+static void *get_aligned_area(unsigned long size, unsigned long alignment)
+{
+	unsigned long addr;
+	void *p;
+
+	p = mmap(NULL, size + 3 * alignment, PROT_NONE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	munmap(p, size + 3 * alignment);
+
+	addr = ((unsigned long)p + alignment - 1) & ~(alignment - 1);
+	if (!(addr & (2 * alignment - 1)))
+		addr += alignment;
+
+	return (void *)addr;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run_test(const struct test *t)
+{
+	unsigned long before[NR_COUNTERS], after[NR_COUNTERS];
+	bool counters;
+	void *src_addr, *dst_addr;
+	char *src, *dst;
+	unsigned long i;
+	double start, elapsed;
+	int i_c;
+
+	src_addr = get_aligned_area(t->size, t->alignment);
+	if (!src_addr) {
+		ksft_test_result_skip("%s: no room for the source\n", t->name);
+		return KSFT_SKIP;
+	}
+	src = mmap(src_addr, t->size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (src == MAP_FAILED) {
+		ksft_test_result_skip("%s: no room for the source\n", t->name);
+		return KSFT_SKIP;
+	}
+
+	for (i = 0; i < t->size; i += page_size)
+		src[i] = (char)(i / page_size);
+
+	dst_addr = get_aligned_area(t->size, t->alignment);
+	if (!dst_addr) {
+		munmap(src, t->size);
+		ksft_test_result_skip("%s: no room for the destination\n",
+				      t->name);
+		return KSFT_SKIP;
+	}
+
+	counters = read_counters(before);
+	start = now();
+	dst = mremap(src, t->size, t->size, MREMAP_MAYMOVE | MREMAP_FIXED,
+		     dst_addr);
+	elapsed = now() - start;
+	if (dst == MAP_FAILED) {
+		ksft_test_result_fail("%s: mremap: %s\n", t->name,
+				      strerror(errno));
+		munmap(src, t->size);
+		return KSFT_FAIL;
+	}
+	counters = counters && read_counters(after);
+
+	for (i = 0; i < t->size; i += page_size) {
+		if (dst[i] != (char)(i / page_size)) {
+			ksft_test_result_fail("%s: data mismatch at %#lx\n",
+					      t->name, i);
+			munmap(dst, t->size);
+			return KSFT_FAIL;
+		}
+	}
+	munmap(dst, t->size);
+
+	ksft_print_msg("%s: %lu MB in %.0f us, %.1f GB/s\n", t->name,
+		       t->size >> 20, elapsed * 1e6,
+		       t->size / elapsed / GB(1));
+	if (counters) {
+		ksft_print_msg("%s:", t->name);
+		for (i_c = 0; i_c < NR_COUNTERS; i_c++)
+			printf(" %s %lu", counter_names[i_c],
+			       after[i_c] - before[i_c]);
+		printf("\n");
+	}
+	ksft_test_result_pass("%s\n", t->name);
+
+	return KSFT_PASS;
+}
+
+#define MAX_TESTS	4
+
+int main(int argc, char **argv)
+{
+	struct test tests[MAX_TESTS];
+	unsigned long size = MB(64);
+	bool pud = false;
+	int i, opt, nr_tests = 0;
+
+	while ((opt = getopt(argc, argv, "s:p")) != -1) {
+		switch (opt) {
+		case 's':
+			size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'p':
+			pud = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-s size_mb] [-p]\n",
+				argv[0]);
+			return KSFT_FAIL;
+		}
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	tests[nr_tests++] = (struct test){ "4KB aligned", size, KB(4) };
+	tests[nr_tests++] = (struct test){ "1MB aligned", size, MB(1) };
+	tests[nr_tests++] = (struct test){ "2MB aligned", size, MB(2) };
+	if (pud)
+		tests[nr_tests++] = (struct test){ "1GB aligned",
+						   size > GB(1) ? size : GB(1),
+						   GB(1) };
+
+	ksft_print_header();
+	ksft_set_plan(nr_tests);
+
+	for (i = 0; i < nr_tests; i++)
+		run_test(&tests[i]);
+
+	if (ksft_get_fail_cnt())
+		return ksft_exit_fail();
+	return ksft_exit_pass();
+}
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * process_madvise() tests.
+ *
+ * Advises vectors of ranges of our own address space through a pidfd:
+ * MADV_POPULATE_READ must fault in every range, a vector that hits an
+ * unmapped hole must stop there by default, and with PMADV_PER_RANGE
+ * must go on and report the bytes advised in each range.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "../kselftest.h"
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open		434
+#endif
+#ifndef __NR_process_madvise
+#define __NR_process_madvise	440
+#endif
+#ifndef MADV_COLD
+#define MADV_COLD		20
+#endif
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ	22
+#endif
+#ifndef PMADV_PER_RANGE
+#define PMADV_PER_RANGE		0x01
+#endif
+
+#define NR_PAGES	4
+
+static unsigned long page_size;
+static int pidfd;
+
+static ssize_t sys_process_madvise(const struct iovec *vec, size_t vlen,
+			       int advice, unsigned int flags)
+{
+	return syscall(__NR_process_madvise, pidfd, vec, vlen, advice, flags);
+}
+
+static int resident_pages(char *addr, unsigned long len)
+{
+	unsigned char vec[NR_PAGES];
+	int i, nr = 0;
+
+	if (mincore(addr, len, vec))
+		ksft_exit_fail_msg("mincore: %s\n", strerror(errno));
+	for (i = 0; i < len / page_size; i++)
+		nr += vec[i] & 1;
+
+	return nr;
+}
+
+/* Three ranges of NR_PAGES, the middle one with an unmapped second half */
+static char *map_ranges(struct iovec *vec)
+{
+	unsigned long len = NR_PAGES * page_size;
+	char *addr;
+	int i;
+
+	addr = mmap(NULL, 3 * len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		ksft_exit_fail_msg("mmap: %s\n", strerror(errno));
+	if (munmap(addr + len + len / 2, len / 2))
+		ksft_exit_fail_msg("munmap: %s\n", strerror(errno));
+
+	for (i = 0; i < 3; i++) {
+		vec[i].iov_base = addr + i * len;
+		vec[i].iov_len = len;
+	}
+
+	return addr;
+}
+
+static void test_populate(void)
+{
+	unsigned long len = NR_PAGES * page_size;
+	struct iovec vec[2];
+	ssize_t ret;
+	char *addr;
+
+	addr = mmap(NULL, 3 * len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		ksft_exit_fail_msg("mmap: %s\n", strerror(errno));
+
+	vec[0].iov_base = addr;
+	vec[0].iov_len = len;
+	vec[1].iov_base = addr + 2 * len;
+	vec[1].iov_len = len;
+
+	ret = sys_process_madvise(vec, 2, MADV_POPULATE_READ, 0);
+	if (ret < 0 && errno == EINVAL)
+		ksft_test_result_skip("MADV_POPULATE_READ not supported\n");
+	else if (ret != 2 * len)
+		ksft_test_result_fail("populate returned %zd: %s\n", ret,
+				      ret < 0 ? strerror(errno) : "short");
+	else if (resident_pages(addr, len) != NR_PAGES ||
+		 resident_pages(addr + 2 * len, len) != NR_PAGES ||
+		 resident_pages(addr + len, len) != 0)
+		ksft_test_result_fail("populate did not fault in the ranges\n");
+	else
+		ksft_test_result_pass("MADV_POPULATE_READ of two ranges\n");
+
+	munmap(addr, 3 * len);
+}
+
+static void test_stop_at_error(void)
+{
+	unsigned long len = NR_PAGES * page_size;
+	struct iovec vec[3];
+	ssize_t ret;
+	char *addr;
+
+	addr = map_ranges(vec);
+
+	/* Either the error or the bytes advised before it are returned */
+	ret = sys_process_madvise(vec, 3, MADV_COLD, 0);
+	if ((ret != -1 || errno != ENOMEM) && ret != len)
+		ksft_test_result_fail("did not stop at the hole: %zd\n", ret);
+	else if (vec[1].iov_len != len)
+		ksft_test_result_fail("iovec changed without PMADV_PER_RANGE\n");
+	else
+		ksft_test_result_pass("unmapped hole fails the vector\n");
+
+	munmap(addr, len + len / 2);
+	munmap(addr + 2 * len, len);
+}
+
+static void test_per_range(void)
+{
+	unsigned long len = NR_PAGES * page_size;
+	struct iovec vec[3];
+	ssize_t ret;
+	char *addr;
+
+	addr = map_ranges(vec);
+
+	ret = sys_process_madvise(vec, 3, MADV_COLD, PMADV_PER_RANGE);
+	if (ret < 0 && errno == EINVAL)
+		ksft_test_result_skip("PMADV_PER_RANGE not supported\n");
+	else if (ret != 2 * len + len / 2)
+		ksft_test_result_fail("per range returned %zd\n", ret);
+	else if (vec[0].iov_len != len || vec[1].iov_len != len / 2 ||
+		 vec[2].iov_len != len)
+		ksft_test_result_fail("per range results %zu %zu %zu\n",
+				      vec[0].iov_len, vec[1].iov_len,
+				      vec[2].iov_len);
+	else
+		ksft_test_result_pass("PMADV_PER_RANGE goes past the hole\n");
+
+	munmap(addr, len + len / 2);
+	munmap(addr + 2 * len, len);
+}
+
+static void test_bad_flags(void)
+{
+	struct iovec vec = { NULL, 0 };
+
+	if (sys_process_madvise(&vec, 1, MADV_COLD, ~0U) != -1 ||
+	    errno != EINVAL)
+		ksft_test_result_fail("unknown flags were accepted\n");
+	else
+		ksft_test_result_pass("unknown flags are rejected\n");
+}
+
+int main(void)
+{
+	struct iovec vec = { NULL, 0 };
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	ksft_print_header();
+
+	pidfd = syscall(__NR_pidfd_open, getpid(), 0);
+	if (pidfd < 0)
+		ksft_exit_skip("pidfd_open: %s\n", strerror(errno));
+
+	if (sys_process_madvise(&vec, 1, MADV_COLD, 0) < 0) {
+		if (errno == ENOSYS)
+			ksft_exit_skip("process_madvise not supported\n");
+		if (errno == EPERM)
+			ksft_exit_skip("process_madvise needs CAP_SYS_NICE\n");
+	}
+
+	ksft_set_plan(4);
+
+	test_populate();
+	test_stop_at_error();
+	test_per_range();
+	test_bad_flags();
+
+	if (ksft_get_fail_cnt())
+		return ksft_exit_fail();
+	return ksft_exit_pass();
+}